@@ -304,6 +304,41 @@ enum PERF_STRATEGY
 };
 
 
+/*****************************************************************************************\
+*                       Allocation counters of the measured code                          *
+\*****************************************************************************************/
+// Counters of the calling thread, provided by the test program (e.g. by its
+// replaced operator new). The harness reads them around every test cycle and
+// reports the allocations, bytes and peak of the live bytes per iteration.
+struct AllocationStats
+{
+    int64 allocations;  // since the start of the thread
+    int64 bytes;
+    int64 live_bytes;
+    int64 peak_bytes;   // the most live bytes since the last read with restart_peak
+};
+
+typedef void (*AllocationStatsHook)(AllocationStats& stats, bool restart_peak);
+
+
+/*****************************************************************************************\
+*                        Hardware counters of the measured code                           *
+\*****************************************************************************************/
+// Event counts of the calling thread since its first read, provided by the
+// test program (e.g. through perf_event_open). The hook leaves the events it
+// cannot count at -1 and returns false if it counts none.
+enum
+{
+    HW_EVENT_CYCLES = 0,
+    HW_EVENT_INSTRUCTIONS,
+    HW_EVENT_CACHE_MISSES,
+    HW_EVENT_BRANCH_MISSES,
+    HW_EVENT_COUNT
+};
+
+typedef bool (*HardwareCountersHook)(int64 values[HW_EVENT_COUNT]);
+
+
 /*****************************************************************************************\
 *                           Base fixture for performance tests                            *
 \*****************************************************************************************/
@@ -322,6 +357,9 @@ public:
     static enum PERF_STRATEGY getPerformanceStrategy();
     static enum PERF_STRATEGY setPerformanceStrategy(enum PERF_STRATEGY strategy);
 
+    static void setAllocationStatsHook(AllocationStatsHook hook);
+    static void setHardwareCountersHook(HardwareCountersHook hook);
+
     class PerfSkipTestException: public cv::Exception {};
 
 protected:
@@ -54,6 +54,450 @@ static void setCurrentThreadAffinityMask(int mask)
 }
 #endif
 
+/*****************************************************************************************\
+*                          Hardware counters of the test cycles                             *
+\*****************************************************************************************/
+
+static bool         param_hw_counters;
+static unsigned int param_iterations;
+static bool         param_latency_histogram;
+static std::string  param_samples_file;
+static std::string  param_baseline;
+static double       param_tolerance;
+static std::string  param_write_baseline;
+
+static const char* hw_event_names[HW_EVENT_COUNT] = { "cycles", "instructions", "cache-misses", "branch-misses" };
+
+// Totals of the current test over all its iterations, -1 if not counted
+static int64 hw_totals[HW_EVENT_COUNT];
+static int64 hw_start[HW_EVENT_COUNT];
+static bool  hw_started;
+
+static HardwareCountersHook hw_hook;
+static bool                 hw_checked;
+
+void TestBase::setHardwareCountersHook(HardwareCountersHook hook)
+{
+    hw_hook = hook;
+}
+
+// The hook counts the thread which runs the tests, that is the one that
+// executes TEST_CYCLE; work of other threads is not included
+static bool readHardwareCounters(int64 values[HW_EVENT_COUNT])
+{
+    for (int i = 0; i < HW_EVENT_COUNT; i++)
+        values[i] = -1;
+    const bool ok = hw_hook && hw_hook(values);
+    if (!hw_checked)
+    {
+        hw_checked = true;
+        if (!ok)
+            LOGD("Hardware counters are not available%s", hw_hook ? "" : ", the test program has not set a hook");
+    }
+    return ok;
+}
+
+static void resetHardwareCounters()
+{
+    for (int i = 0; i < HW_EVENT_COUNT; i++)
+        hw_totals[i] = -1;
+}
+
+static void startHardwareCounters()
+{
+    hw_started = param_hw_counters && readHardwareCounters(hw_start);
+}
+
+static void stopHardwareCounters()
+{
+    if (!hw_started)
+        return;
+    hw_started = false;
+
+    int64 values[HW_EVENT_COUNT];
+    if (!readHardwareCounters(values))
+        return;
+    for (int i = 0; i < HW_EVENT_COUNT; i++)
+    {
+        if (values[i] >= 0 && hw_start[i] >= 0)
+            hw_totals[i] = std::max<int64>(hw_totals[i], 0) + values[i] - hw_start[i];
+    }
+}
+
+/*****************************************************************************************\
+*                        Allocations of the test cycles                                    *
+\*****************************************************************************************/
+
+static AllocationStatsHook alloc_hook;
+
+// Totals of the current test, the peak is the largest of a single iteration
+static int64 alloc_allocations;
+static int64 alloc_bytes;
+static int64 alloc_peak;
+static AllocationStats alloc_start;
+static bool alloc_started;
+
+void TestBase::setAllocationStatsHook(AllocationStatsHook hook)
+{
+    alloc_hook = hook;
+}
+
+static void resetAllocationStats()
+{
+    alloc_allocations = alloc_bytes = alloc_peak = 0;
+}
+
+static void startAllocationStats()
+{
+    alloc_started = alloc_hook != 0;
+    if (alloc_started)
+        alloc_hook(alloc_start, true);
+}
+
+static void stopAllocationStats()
+{
+    if (!alloc_started)
+        return;
+    alloc_started = false;
+
+    AllocationStats stats;
+    alloc_hook(stats, false);
+    alloc_allocations += stats.allocations - alloc_start.allocations;
+    alloc_bytes += stats.bytes - alloc_start.bytes;
+    alloc_peak = std::max(alloc_peak, stats.peak_bytes - alloc_start.live_bytes);
+}
+
+/*****************************************************************************************\
+*                        Latency distribution of the test iterations                       *
+\*****************************************************************************************/
+
+// Iteration times of the current test in the order they were measured,
+// calcMetrics sorts and filters its own vector
+static std::vector<int64> latency_samples;
+
+static const int LATENCY_HISTOGRAM_BINS = 10;
+static const int LATENCY_HISTOGRAM_WIDTH = 40;
+
+// Nearest-rank percentile of sorted samples
+static double latencyPercentile(const std::vector<int64>& sorted, double percent)
+{
+    size_t rank = (size_t)ceil(percent / 100. * sorted.size());
+    return (double)sorted[std::max<size_t>(rank, 1) - 1];
+}
+
+static void reportLatency(double frequency, unsigned int runsPerIteration, bool toJUnitXML)
+{
+    if (latency_samples.empty())
+        return;
+
+    std::vector<int64> sorted(latency_samples);
+    std::sort(sorted.begin(), sorted.end());
+
+    // Per iteration, as the other metrics
+    const double p50 = latencyPercentile(sorted, 50) / runsPerIteration;
+    const double p90 = latencyPercentile(sorted, 90) / runsPerIteration;
+    const double p99 = latencyPercentile(sorted, 99) / runsPerIteration;
+    const double worst = (double)sorted.back() / runsPerIteration;
+    const double to_ms = 1e3 / frequency;
+
+    if (toJUnitXML)
+    {
+        ::testing::Test::RecordProperty("p50", cv::format("%.0f", p50).c_str());
+        ::testing::Test::RecordProperty("p90", cv::format("%.0f", p90).c_str());
+        ::testing::Test::RecordProperty("p99", cv::format("%.0f", p99).c_str());
+        ::testing::Test::RecordProperty("max", cv::format("%.0f", worst).c_str());
+    }
+    printf("[ LATENCY  ] \tp50 = %.2fms, p90 = %.2fms, p99 = %.2fms, max = %.2fms of %d samples\n",
+           p50 * to_ms, p90 * to_ms, p99 * to_ms, worst * to_ms, (int)sorted.size());
+
+    if (param_latency_histogram)
+    {
+        // Equal bins between the fastest and the slowest iteration
+        const double lo = (double)sorted.front() / runsPerIteration;
+        const double bin_width = std::max(1., (worst - lo) / LATENCY_HISTOGRAM_BINS);
+        int counts[LATENCY_HISTOGRAM_BINS] = { 0 };
+        for (size_t i = 0; i < sorted.size(); i++)
+            counts[std::min(LATENCY_HISTOGRAM_BINS - 1, (int)(((double)sorted[i] / runsPerIteration - lo) / bin_width))]++;
+
+        const int most = *std::max_element(counts, counts + LATENCY_HISTOGRAM_BINS);
+        std::string histogram;
+        for (int b = 0; b < LATENCY_HISTOGRAM_BINS; b++)
+        {
+            const std::string bar(counts[b] * LATENCY_HISTOGRAM_WIDTH / most, '#');
+            printf("[ LATENCY  ] \t%9.2f - %9.2fms |%-*s| %d\n", (lo + b * bin_width) * to_ms,
+                   (lo + (b + 1) * bin_width) * to_ms, LATENCY_HISTOGRAM_WIDTH, bar.c_str(), counts[b]);
+            histogram += cv::format(b ? ",%d" : "%d", counts[b]);
+        }
+        if (toJUnitXML)
+            ::testing::Test::RecordProperty("histogram", histogram.c_str());
+    }
+    fflush(stdout);
+}
+
+// One CSV line per iteration, appended after every test
+static void dumpLatencySamples(double frequency, unsigned int runsPerIteration)
+{
+    if (param_samples_file.empty() || latency_samples.empty())
+        return;
+
+    FILE* f = fopen(param_samples_file.c_str(), "a");
+    if (!f)
+    {
+        LOGE("Failed to open %s for the samples", param_samples_file.c_str());
+        return;
+    }
+
+    const ::testing::TestInfo* const test_info = ::testing::UnitTest::GetInstance()->current_test_info();
+    const char* value_param = test_info->value_param();
+    for (size_t i = 0; i < latency_samples.size(); i++)
+    {
+        fprintf(f, "%s.%s,\"%s\",%d,%.0f,%.4f\n", test_info->test_case_name(), test_info->name(),
+                value_param ? value_param : "", (int)i, (double)latency_samples[i] / runsPerIteration,
+                latency_samples[i] * 1e3 / frequency / runsPerIteration);
+    }
+    fclose(f);
+}
+
+/*****************************************************************************************\
+*                       Comparison with the results of a baseline run                      *
+\*****************************************************************************************/
+
+struct BaselineResult
+{
+    std::string name;       // test case and test name
+    std::string params;
+    double median_ms;
+};
+
+static std::vector<BaselineResult> baseline_results;
+static std::vector<BaselineResult> current_results;
+static bool baseline_loaded;
+
+static bool endsWith(const std::string& s, const std::string& suffix)
+{
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+static std::string readFile(const std::string& path)
+{
+    std::string content;
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f)
+        return content;
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0)
+        content.append(buffer, n);
+    fclose(f);
+    return content;
+}
+
+static std::string xmlUnescape(const std::string& s)
+{
+    static const char* entities[][2] = { { "&quot;", "\"" }, { "&apos;", "'" }, { "&lt;", "<" }, { "&gt;", ">" }, { "&amp;", "&" } };
+    std::string result;
+    for (size_t i = 0; i < s.size(); i++)
+    {
+        bool replaced = false;
+        for (size_t e = 0; e < sizeof(entities) / sizeof(entities[0]) && !replaced; e++)
+        {
+            if (s.compare(i, strlen(entities[e][0]), entities[e][0]) == 0)
+            {
+                result += entities[e][1];
+                i += strlen(entities[e][0]) - 1;
+                replaced = true;
+            }
+        }
+        if (!replaced)
+            result += s[i];
+    }
+    return result;
+}
+
+static bool xmlAttribute(const std::string& tag, const std::string& name, std::string& value)
+{
+    const std::string key = " " + name + "=\"";
+    size_t begin = tag.find(key);
+    if (begin == std::string::npos)
+        return false;
+    begin += key.size();
+    size_t end = tag.find('"', begin);
+    if (end == std::string::npos)
+        return false;
+    value = xmlUnescape(tag.substr(begin, end - begin));
+    return true;
+}
+
+// <testcase> elements of a --gtest_output=xml report, the median is in ticks
+static void loadBaselineXML(const std::string& content)
+{
+    size_t pos = 0;
+    while ((pos = content.find("<testcase ", pos)) != std::string::npos)
+    {
+        size_t end = content.find('>', pos);
+        if (end == std::string::npos)
+            break;
+        const std::string tag = content.substr(pos, end - pos);
+        pos = end;
+
+        BaselineResult r;
+        std::string test_case, median, frequency;
+        if (!xmlAttribute(tag, "classname", test_case) || !xmlAttribute(tag, "name", r.name) ||
+            !xmlAttribute(tag, "median", median) || !xmlAttribute(tag, "frequency", frequency))
+            continue;
+        xmlAttribute(tag, "value_param", r.params);
+        r.name = test_case + "." + r.name;
+        r.median_ms = atof(median.c_str()) * 1e3 / atof(frequency.c_str());
+        baseline_results.push_back(r);
+    }
+}
+
+static std::string jsonString(const std::string& content, size_t& pos)
+{
+    std::string value;
+    pos = content.find('"', pos);
+    if (pos == std::string::npos)
+        return value;
+    for (pos++; pos < content.size() && content[pos] != '"'; pos++)
+    {
+        if (content[pos] == '\\' && pos + 1 < content.size())
+            pos++;
+        value += content[pos];
+    }
+    return value;
+}
+
+static std::string jsonEscape(const std::string& s)
+{
+    std::string result;
+    for (size_t i = 0; i < s.size(); i++)
+    {
+        if (s[i] == '"' || s[i] == '\\')
+            result += '\\';
+        result += s[i];
+    }
+    return result;
+}
+
+// The format written by --perf_write_baseline, a "name", "params" and
+// "median_ms" object per test
+static void loadBaselineJSON(const std::string& content)
+{
+    size_t pos = content.find('[');
+    while (pos != std::string::npos && (pos = content.find('{', pos)) != std::string::npos)
+    {
+        const size_t end = content.find('}', pos);
+        if (end == std::string::npos)
+            break;
+        const std::string object = content.substr(pos, end - pos);
+        pos = end;
+
+        BaselineResult r;
+        size_t name = object.find("\"name\"");
+        size_t params = object.find("\"params\"");
+        size_t median = object.find("\"median_ms\"");
+        if (name == std::string::npos || median == std::string::npos)
+            continue;
+        name += 6;
+        r.name = jsonString(object, name);
+        if (params != std::string::npos)
+        {
+            params += 8;
+            r.params = jsonString(object, params);
+        }
+        median = object.find(':', median);
+        r.median_ms = atof(object.c_str() + median + 1);
+        baseline_results.push_back(r);
+    }
+}
+
+static void loadBaseline(const std::string& path)
+{
+    const std::string content = readFile(path);
+    if (endsWith(path, ".json"))
+        loadBaselineJSON(content);
+    else
+        loadBaselineXML(content);
+    baseline_loaded = !baseline_results.empty();
+    if (!baseline_loaded)
+        LOGE("No test results in the baseline %s", path.c_str());
+}
+
+// The index in the name of a parameterized test changes when values are
+// added to its list, so the parameters have to match as well
+static const BaselineResult* findBaseline(const BaselineResult& r)
+{
+    for (size_t i = 0; i < baseline_results.size(); i++)
+    {
+        if (baseline_results[i].name == r.name && baseline_results[i].params == r.params)
+            return &baseline_results[i];
+    }
+    return 0;
+}
+
+// Fails the current test if it is slower than the baseline beyond the tolerance
+static void compareWithBaseline(double median_ms)
+{
+    const ::testing::TestInfo* const test_info = ::testing::UnitTest::GetInstance()->current_test_info();
+    BaselineResult r;
+    r.name = std::string(test_info->test_case_name()) + "." + test_info->name();
+    r.params = test_info->value_param() ? test_info->value_param() : "";
+    r.median_ms = median_ms;
+    current_results.push_back(r);
+
+    const BaselineResult* base = baseline_loaded ? findBaseline(r) : 0;
+    if (base && median_ms > base->median_ms * (1 + param_tolerance / 100))
+    {
+        ADD_FAILURE() << "  Slower than the baseline: " << cv::format("%.3f", median_ms) << " ms vs "
+                      << cv::format("%.3f", base->median_ms) << " ms, the tolerance is " << param_tolerance << "%";
+    }
+}
+
+static void writeBaseline(const std::string& path)
+{
+    FILE* f = fopen(path.c_str(), "w");
+    if (!f)
+    {
+        LOGE("Failed to write the baseline %s", path.c_str());
+        return;
+    }
+    fprintf(f, "{\n  \"tests\": [\n");
+    for (size_t i = 0; i < current_results.size(); i++)
+    {
+        const BaselineResult& r = current_results[i];
+        fprintf(f, "    { \"name\": \"%s\", \"params\": \"%s\", \"median_ms\": %.6f }%s\n",
+                jsonEscape(r.name).c_str(), jsonEscape(r.params).c_str(), r.median_ms,
+                i + 1 < current_results.size() ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+    fclose(f);
+}
+
+// x-factor is the baseline time over the current one, below 1 is slower
+static void printBaselineTable()
+{
+    printf("[ BASELINE ] %-56s %12s %12s %9s\n", "Name of Test", "base", "current", "x-factor");
+    int slower = 0;
+    for (size_t i = 0; i < current_results.size(); i++)
+    {
+        const BaselineResult& r = current_results[i];
+        const BaselineResult* base = findBaseline(r);
+        const std::string name = r.params.empty() ? r.name : r.name + "::" + r.params;
+        if (!base)
+        {
+            printf("[ BASELINE ] %-56s %12s %9.3f ms %9s\n", name.c_str(), "-", r.median_ms, "new");
+            continue;
+        }
+        const bool is_slower = r.median_ms > base->median_ms * (1 + param_tolerance / 100);
+        slower += is_slower;
+        printf("[ BASELINE ] %-56s %9.3f ms %9.3f ms %9.2f%s\n", name.c_str(), base->median_ms, r.median_ms,
+               base->median_ms / r.median_ms, is_slower ? "  << slower" : "");
+    }
+    printf("[ BASELINE ] %d of %d tests are slower than the baseline by more than %g%%\n",
+           slower, (int)current_results.size(), param_tolerance);
+    fflush(stdout);
+}
+
 namespace {
 
 class PerfEnvironment: public ::testing::Environment
@@ -62,6 +506,16 @@ public:
     void TearDown()
     {
         cv::setNumThreads(-1);
+
+        if (!param_baseline.empty())
+        {
+            if (baseline_loaded)
+                printBaselineTable();
+            else
+                ADD_FAILURE() << "  No test results in the baseline " << param_baseline;
+        }
+        if (!param_write_baseline.empty())
+            writeBaseline(param_write_baseline);
     }
 };
 
@@ -660,6 +1114,13 @@ void TestBase::Init(const std::vector<std::string> & availableImpls,
         "{   |perf_time_limit             |3.0      |default time limit for a single test (in seconds)}"
 #endif
         "{   |perf_max_deviation          |1.0      |}"
+        "{   |perf_hw_counters            |false    |count cycles, instructions, cache and branch misses of the test cycles (Linux)}"
+        "{   |perf_iterations             |0        |run exactly this number of iterations, ignoring the time and sample limits}"
+        "{   |perf_latency_histogram      |false    |print a histogram of the iteration times of every test}"
+        "{   |perf_samples_file           |         |write the time of every iteration to this CSV file}"
+        "{   |perf_baseline               |         |fail the tests slower than in this results file (.json or gtest .xml)}"
+        "{   |perf_tolerance              |10       |allowed slowdown against the baseline, in percent}"
+        "{   |perf_write_baseline         |         |write the medians of this run as a .json baseline}"
         "{h  |help                        |false    |print help info}"
 #ifdef HAVE_CUDA
         "{   |perf_cuda_device            |0        |run GPU test suite onto specific CUDA capable device}"
@@ -706,6 +1167,26 @@ void TestBase::Init(const std::vector<std::string> & availableImpls,
     param_write_sanity  = args.get<bool>("perf_write_sanity");
     param_verify_sanity = args.get<bool>("perf_verify_sanity");
     param_threads  = args.get<int>("perf_threads");
+    param_hw_counters = args.get<bool>("perf_hw_counters");
+    param_iterations = args.get<unsigned int>("perf_iterations");
+    param_latency_histogram = args.get<bool>("perf_latency_histogram");
+    param_samples_file = args.get<std::string>("perf_samples_file");
+    param_baseline = args.get<std::string>("perf_baseline");
+    param_tolerance = std::max(0., args.get<double>("perf_tolerance"));
+    param_write_baseline = args.get<std::string>("perf_write_baseline");
+    if (!param_baseline.empty())
+        loadBaseline(param_baseline);
+    if (!param_samples_file.empty())
+    {
+        FILE* f = fopen(param_samples_file.c_str(), "w");
+        if (f)
+        {
+            fprintf(f, "test,params,iteration,ticks,ms\n");
+            fclose(f);
+        }
+        else
+            LOGE("Failed to create %s for the samples", param_samples_file.c_str());
+    }
 #ifdef ANDROID
     param_affinity_mask   = args.get<int>("perf_affinity_mask");
     log_power_checkpoints = args.get<bool>("perf_log_power_checkpoints");
@@ -911,6 +1392,9 @@ bool TestBase::next()
     {
         lastActivityPrintTime = 0;
         metrics.clear();
+        resetHardwareCounters();
+        resetAllocationStats();
+        latency_samples.clear();
     }
 
     cv::theRNG().state = param_seed; //this rng should generate same numbers for each run
@@ -926,7 +1410,11 @@ bool TestBase::next()
             break;
         }
 
-        if (param_strategy == PERF_STRATEGY_BASE)
+        if (param_iterations > 0)
+        {
+            has_next = currentIter < param_iterations;
+        }
+        else if (param_strategy == PERF_STRATEGY_BASE)
         {
             has_next = currentIter < nIters && totalTime < timeLimit;
         }
@@ -1012,12 +1500,16 @@ unsigned int TestBase::getTotalOutputSize() const
 
 void TestBase::startTimer()
 {
+    startAllocationStats();
+    startHardwareCounters();
     lastTime = cv::getTickCount();
 }
 
 void TestBase::stopTimer()
 {
     int64 time = cv::getTickCount();
+    stopHardwareCounters();
+    stopAllocationStats();
     if (lastTime == 0)
         ADD_FAILURE() << "  stopTimer() is called before startTimer()/next()";
     lastTime = time - lastTime;
@@ -1025,6 +1517,7 @@ void TestBase::stopTimer()
     lastTime -= _timeadjustment;
     if (lastTime < 0) lastTime = 0;
     times.push_back(lastTime);
+    latency_samples.push_back(lastTime);
     lastTime = 0;
 }
 
@@ -1147,8 +1640,11 @@ void TestBase::validateMetrics()
 
     if (param_strategy == PERF_STRATEGY_BASE)
     {
-        EXPECT_GE(m.samples, param_min_samples)
-          << "  Only a few samples are collected.\nPlease increase number of iterations or/and time limit to get reliable performance measurements.";
+        if (param_iterations == 0)
+        {
+            EXPECT_GE(m.samples, param_min_samples)
+              << "  Only a few samples are collected.\nPlease increase number of iterations or/and time limit to get reliable performance measurements.";
+        }
 
         if (m.gstddev > DBL_EPSILON)
         {
@@ -1197,6 +1693,47 @@ void TestBase::reportMetrics(bool toJUnitXML)
         RecordProperty("gstddev", cv::format("%.6f", m.gstddev).c_str());
         RecordProperty("mean", cv::format("%.0f", m.mean).c_str());
         RecordProperty("stddev", cv::format("%.0f", m.stddev).c_str());
+
+        if (param_hw_counters && m.samples > 0)
+        {
+            // Per pixel of the declared inputs
+            double pixels = 0;
+            for (SizeVector::const_iterator i = inputData.begin(); i != inputData.end(); ++i)
+                pixels += (double)i->second.area();
+            pixels *= m.samples;
+
+            for (int i = 0; i < HW_EVENT_COUNT; i++)
+            {
+                if (hw_totals[i] < 0)
+                    continue;
+                RecordProperty(hw_event_names[i], cv::format("%.0f", (double)hw_totals[i] / m.samples).c_str());
+                printf("[ HW       ] \t%-14s = %14.0f per iteration", hw_event_names[i], (double)hw_totals[i] / m.samples);
+                if (pixels > 0 && i != HW_EVENT_CYCLES && i != HW_EVENT_INSTRUCTIONS)
+                    printf(", %.4f per pixel", hw_totals[i] / pixels);
+                printf("\n");
+            }
+            if (hw_totals[HW_EVENT_CYCLES] > 0 && hw_totals[HW_EVENT_INSTRUCTIONS] >= 0)
+            {
+                const double ipc = (double)hw_totals[HW_EVENT_INSTRUCTIONS] / hw_totals[HW_EVENT_CYCLES];
+                RecordProperty("ipc", cv::format("%.3f", ipc).c_str());
+                printf("[ HW       ] \tIPC            = %14.2f\n", ipc);
+            }
+            if (hw_totals[HW_EVENT_CYCLES] >= 0)
+                printf("[ HW       ] \tevents of the thread running TEST_CYCLE only, its parallel_for_ workers are not counted\n");
+            fflush(stdout);
+        }
+
+        if (alloc_hook && !latency_samples.empty())
+        {
+            const double runs = (double)latency_samples.size() * runsPerIteration;
+            RecordProperty("allocations", cv::format("%.1f", alloc_allocations / runs).c_str());
+            RecordProperty("alloc_bytes", cv::format("%.0f", alloc_bytes / runs).c_str());
+            RecordProperty("peak_bytes", cv::format("%lld", (long long)alloc_peak).c_str());
+            printf("[ MEMORY   ] \tallocations    = %14.1f per iteration\n", alloc_allocations / runs);
+            printf("[ MEMORY   ] \tallocated      = %14.1f KB per iteration\n", alloc_bytes / runs / 1024.);
+            printf("[ MEMORY   ] \tpeak           = %14.1f KB\n", alloc_peak / 1024.);
+            fflush(stdout);
+        }
     }
     else
     {
@@ -1249,6 +1786,12 @@ void TestBase::reportMetrics(bool toJUnitXML)
             LOGD("stddev    =%11.0f = %.2fms", m.stddev, m.stddev * 1e3 / m.frequency);
         }
     }
+
+    if (m.terminationReason != performance_metrics::TERM_SKIP_TEST)
+    {
+        reportLatency(m.frequency, runsPerIteration, toJUnitXML);
+        dumpLatencySamples(m.frequency, runsPerIteration);
+    }
 }
 
 void TestBase::SetUp()
@@ -1299,6 +1842,10 @@ void TestBase::TearDown()
     if (value_param) printf("[ VALUE    ] \t%s\n", value_param), fflush(stdout);
     if (type_param)  printf("[ TYPE     ] \t%s\n", type_param), fflush(stdout);
     reportMetrics(true);
+
+    if ((!param_baseline.empty() || !param_write_baseline.empty()) &&
+        metrics.terminationReason != performance_metrics::TERM_SKIP_TEST && metrics.samples > 0)
+        compareWithBaseline(metrics.median * 1e3 / metrics.frequency);
 }
 
 std::string TestBase::getDataPath(const std::string& relativePath)
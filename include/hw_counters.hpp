@@ -0,0 +1,21 @@
+#pragma once
+
+#include "opencv2/core/core.hpp"
+
+// Hardware event counts of the calling thread since its first read,
+// an event is -1 if it cannot be counted on this system
+struct HardwareEvents
+{
+    HardwareEvents() : cycles(0), instructions(0), cache_misses(0), branch_misses(0) {}
+
+    int64 cycles;
+    int64 instructions;
+    int64 cache_misses;
+    int64 branch_misses;
+};
+
+// Counters are opened through Linux perf_event_open on the first read in
+// every thread. Elsewhere, or when the kernel refuses (no PMU in a VM,
+// perf_event_paranoid), reads return false and the events are left at -1.
+bool HardwareCounters_Read(HardwareEvents& events);
+bool HardwareCounters_Available();
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "opencv2/core/core.hpp"
+
+#include <string>
+
+// Background writer of the intermediate images saved by skeletonize.
+// ImageWriter_Write only copies the image into a bounded queue, encoding and
+// disk I/O happen on a separate thread, so the pipeline's timings stay
+// close to the ones without saving. A full queue blocks the caller.
+//
+// The format is taken from the SKELETON_DUMP_FORMAT environment variable
+// on first use (png or pnm) and can be changed by ImageWriter_SetFormat.
+// PNM files are written uncompressed, which is several times faster
+// than PNG for large images. Pending images are written at exit.
+
+enum ImageDumpFormat
+{
+    IMAGE_DUMP_PNG = 0,
+    IMAGE_DUMP_PNM      // .pgm or .ppm instead of the file's extension
+};
+
+void ImageWriter_SetFormat(ImageDumpFormat format);
+ImageDumpFormat ImageWriter_GetFormat();
+
+void ImageWriter_Write(const std::string& filename, const cv::Mat& image);
+
+// Blocks until every queued image is written, returns the number of
+// images which failed to write since the previous call
+int ImageWriter_Flush();
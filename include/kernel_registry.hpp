@@ -0,0 +1,95 @@
+#pragma once
+
+#include "opencv2/core/core.hpp"
+
+#include <string>
+#include <vector>
+
+// Registry of the implementations of every pipeline stage. skeletonize calls
+// the kernel selected for each stage, so a faster variant can be deployed or
+// rolled back without rebuilding. The selection is taken from the
+// SKELETON_KERNELS environment variable on first use, e.g.
+//   SKELETON_KERNELS=convertcolor=simd,thinning=bitpacked
+// and can be changed at any time by Kernels_Select or Kernels_Configure.
+// By default every stage runs its reference implementation.
+//
+// With SKELETON_AUTOTUNE=1 skeletonize instead picks the fastest kernel of
+// every stage on first use of an image size and runs those for the images
+// of that size, leaving the selection as it is, see Kernels_Autotune.
+
+enum KernelStage
+{
+    KERNEL_CONVERTCOLOR = 0,
+    KERNEL_RESIZE,
+    KERNEL_THINNING,
+    KERNEL_STAGE_COUNT
+};
+
+enum KernelFlags
+{
+    KERNEL_EXACT     = 1 << 0,  // bit-exact with the reference implementation
+    KERNEL_SSSE3     = 1 << 1,  // needs the CPU to support the instruction set
+    KERNEL_AVX2      = 1 << 2,
+    KERNEL_AVX512BW  = 1 << 3,
+    KERNEL_PARALLEL  = 1 << 4   // runs on several threads
+};
+
+typedef void (*ConvertColorKernel)(const cv::Mat& src, cv::Mat& dst);
+typedef void (*ImageResizeKernel)(const cv::Mat& src, cv::Mat& dst, const cv::Size sz);
+typedef void (*ThinningKernel)(const cv::Mat& src, cv::Mat& dst);
+
+// Only the function of the kernel's stage is set
+struct KernelInfo
+{
+    KernelStage stage;
+    std::string name;
+    int flags;
+
+    ConvertColorKernel convert;
+    ImageResizeKernel resize;
+    ThinningKernel thinning;
+};
+
+const char* Kernels_StageName(KernelStage stage);
+
+// A kernel with the name of a registered one replaces it
+void Kernels_Register(const KernelInfo& kernel);
+std::vector<KernelInfo> Kernels_List(KernelStage stage);
+
+// Whether the CPU and the build support the kernel's instruction set
+bool Kernels_Supported(const KernelInfo& kernel);
+
+// Both return false and keep the previous choice for an unknown
+// or unsupported kernel
+bool Kernels_Select(KernelStage stage, const std::string& name);
+bool Kernels_Configure(const std::string& config);
+
+KernelInfo Kernels_Selected(KernelStage stage);
+
+ConvertColorKernel Kernels_ConvertColor();
+ImageResizeKernel Kernels_ImageResize();
+ThinningKernel Kernels_Thinning();
+
+// The kernels skeletonize calls, taken together, so that a call does not
+// mix two selections
+struct KernelSet
+{
+    ConvertColorKernel convert;
+    ImageResizeKernel resize;
+    ThinningKernel thinning;
+};
+
+KernelSet Kernels_SelectedSet();
+
+// Times every supported kernel of each stage on a synthetic image of the
+// size and selects the fastest one with which the pipeline gives the same
+// binary (for thinning: thinned) image as with the reference. The choice is
+// cached per stage, image size and CPU model in cache_path (by default
+// SKELETON_TUNE_CACHE or skeleton_tune.cache), so only new combinations are
+// measured. Returns the number of stages measured.
+int Kernels_Autotune(const cv::Size& input_size, const std::string& cache_path = std::string());
+// The same, but the kernels are returned instead of selected, so calls for
+// different sizes do not change each other's kernels
+int Kernels_Autotune(const cv::Size& input_size, KernelSet& kernels, const std::string& cache_path = std::string());
+bool Kernels_AutotuneEnabled();
+std::string Kernels_AutotuneCachePath();
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "opencv2/core/core.hpp"
+
+// Pool of the buffers of the pipeline's intermediate images. Blocks are
+// 64-byte aligned and kept by size class (four classes per power of two,
+// up to 16 free blocks each) after their Mat is released, so the next image
+// of a similar size reuses one instead of going to the heap. The pool is
+// shared by all threads.
+//
+// It is on by default; SKELETON_MAT_POOL=0 at startup or MatPool_SetEnabled
+// switches the pipeline back to plain (counted) allocations. Mats keep the
+// allocator they were created with, so switching is safe at any time.
+struct MatPoolStats
+{
+    int64 hits;          // allocations served from the pool
+    int64 misses;        // allocations which went to the heap
+    int64 cached_bytes;  // free blocks kept in the pool
+};
+
+// Allocator for the intermediate Mats: the pool while it is enabled,
+// Memory_MatAllocator otherwise. Both are counted in the memory statistics:
+// blocks from the heap as allocations, blocks from the pool as reuses.
+cv::MatAllocator* MatPool_Allocator();
+
+void MatPool_SetEnabled(bool enabled);
+bool MatPool_IsEnabled();
+
+// Free blocks above the limit go back to the heap (256 MB by default)
+void MatPool_SetLimit(size_t bytes);
+
+// Returns the cached blocks to the heap
+void MatPool_Trim();
+
+MatPoolStats MatPool_GetStats();
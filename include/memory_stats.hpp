@@ -0,0 +1,35 @@
+#pragma once
+
+#include "opencv2/core/core.hpp"
+
+// Allocation counters of the calling thread. They count the Mats allocated
+// by Memory_MatAllocator, which the pipeline uses for its intermediate
+// images, and everything reported by Memory_RecordAlloc/Memory_RecordFree.
+// A program which wants operator new counted too replaces it and reports
+// to these functions, as perf_skeleton does.
+struct MemoryCounters
+{
+    MemoryCounters() : allocations(0), bytes(0), reuses(0), live_bytes(0), peak_bytes(0) {}
+
+    int64 allocations;  // since the start of the thread
+    int64 bytes;
+    int64 reuses;       // buffers served from a pool, not in the allocations
+    int64 live_bytes;   // allocated and not freed yet, negative if other threads free this one's memory
+    int64 peak_bytes;   // the most live bytes since Memory_BeginPeak
+};
+
+void Memory_RecordAlloc(size_t bytes);
+void Memory_RecordFree(size_t bytes);
+
+// A pooled buffer taken again: live and peak bytes as for an allocation
+void Memory_RecordReuse(size_t bytes);
+
+MemoryCounters Memory_ReadCounters();
+
+// Restarts the peak from the current live bytes and returns the previous
+// peak, which Memory_EndPeak restores so that scopes can be nested
+int64 Memory_BeginPeak();
+void Memory_EndPeak(int64 outer_peak);
+
+// Counting allocator for cv::Mat::allocator, set before the Mat is created
+cv::MatAllocator* Memory_MatAllocator();
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "opencv2/core/core.hpp"
+#include "hw_counters.hpp"
+#include "memory_stats.hpp"
+
+#include <string>
+#include <vector>
+
+// Per-stage profiler of the pipeline. Every stage is wrapped into a
+// PROFILE_SCOPE, durations are accumulated into a histogram per stage name.
+// While disabled a scope costs a single flag check. Recording does not
+// allocate; up to 64 distinct stages are kept between resets.
+//
+// The profiler is switched at runtime, by Profiler_SetEnabled or by the
+// SKELETON_PROFILE environment variable read at startup:
+//   SKELETON_PROFILE=1            - print the summary to stdout at exit
+//   SKELETON_PROFILE=<file>.json  - write the summary as JSON at exit
+//   SKELETON_PROFILE=<file>.csv   - write the summary as CSV at exit
+//
+// With SKELETON_PROFILE_COUNTERS=1 (or Profiler_SetHardwareCounters) every
+// scope also counts hardware events, reported as IPC and misses per pixel.
+// Without access to the counters the profiler silently keeps timing only.
+// The events are those of the calling thread: a stage which hands work to
+// the parallel_for_ pool misses that work and is marked in the report.
+//
+// Every scope also records the allocations made on its thread while it
+// runs and the peak of the memory they held, see memory_stats.hpp.
+
+struct ProfilerStageStats
+{
+    std::string name;
+    int calls;
+    double total_ms;
+    double min_ms;
+    double median_ms;   // median and p99 are accurate to a histogram bin (~9%)
+    double p99_ms;
+    double max_ms;
+
+    // Sums over all calls, events are -1 when they were not counted
+    int64 pixels;
+    HardwareEvents events;
+    bool events_calling_thread_only;    // some calls ran work on other threads
+
+    int64 allocations;  // sums over all calls
+    int64 alloc_bytes;
+    int64 peak_bytes;   // the largest peak of a single call
+};
+
+void Profiler_SetEnabled(bool enabled);
+bool Profiler_IsEnabled();
+
+// Returns false if the counters are not available
+bool Profiler_SetHardwareCounters(bool enabled);
+bool Profiler_HardwareCountersEnabled();
+
+// Thread-safe, may be called from any pipeline thread
+// 'memory' has the allocations, bytes and peak of this call
+void Profiler_Record(const char* stage, int64 ticks, int64 pixels = 0,
+                     const HardwareEvents* events = 0, const MemoryCounters* memory = 0,
+                     bool calling_thread_only = false);
+
+// Called before handing work to other threads; the scopes open on the
+// calling thread are reported with events of the calling thread only
+void Profiler_NoteOtherThreads();
+
+void Profiler_Reset();
+std::vector<ProfilerStageStats> Profiler_GetStats();
+
+void Profiler_Print();
+bool Profiler_WriteJSON(const std::string& path);
+bool Profiler_WriteCSV(const std::string& path);
+
+class ProfileScope
+{
+public:
+    explicit ProfileScope(const char* stage, int64 pixels = 0)
+        : stage_(stage), pixels_(pixels), start_(0), counting_(false), outer_peak_(0), start_handoffs_(0)
+    {
+        if (Profiler_IsEnabled())
+            begin();
+    }
+    ~ProfileScope()
+    {
+        if (start_)
+            end();
+    }
+
+private:
+    ProfileScope(const ProfileScope&);
+    ProfileScope& operator=(const ProfileScope&);
+
+    void begin();
+    void end();
+
+    const char* stage_;
+    int64 pixels_;
+    int64 start_;
+    bool counting_;
+    HardwareEvents start_events_;
+    MemoryCounters start_memory_;
+    int64 outer_peak_;
+    int start_handoffs_;
+};
+
+#define PROFILE_SCOPE(name) ProfileScope profile_scope_##name(#name)
+// The same with the number of processed pixels for per-pixel event rates
+#define PROFILE_SCOPE_PIXELS(name, pixels) ProfileScope profile_scope_##name(#name, pixels)
@@ -2,27 +2,144 @@
 
 #include "opencv2/core/core.hpp"
 
-// Macros for time measurements
-#include <stdio.h>
-#if 1
-    #define TS(name) int64 t_##name = cv::getTickCount()
-    #define TE(name) printf("TIMER_" #name ": %.2fms\n", \
-        1000.f * ((cv::getTickCount() - t_##name) / cv::getTickFrequency()))
-#else
-    #define TS(name)
-    #define TE(name)
-#endif
-
-// Pipeline
-void skeletonize(const cv::Mat& input, cv::Mat& output, bool save_images);
+#include <vector>
+#include <string>
+
+// Per-stage time measurements
+#include "profiler.hpp"
+// Choice of the implementation of every stage
+#include "kernel_registry.hpp"
+// Saving of the intermediate images off the pipeline's thread
+#include "image_writer.hpp"
+// Reuse of the buffers of the intermediate images
+#include "mat_pool.hpp"
+
+// Pipeline, the stages run the kernels selected in the registry.
+// With save_images the intermediate images are queued to the ImageWriter.
+void skeletonize(const cv::Mat& input, cv::Mat& output, bool save_images, bool fused_frontend = false);
+
+// Pipeline for a list of images (or image files) on a pool of 'nthreads' workers
+// (0 - the current OpenCV setting). Outputs follow the order of the inputs,
+// an empty input or a file which cannot be read gives an empty output.
+// Every worker runs a SkeletonPipeline, so the batch uses its fixed kernels.
+void skeletonize_batch(const std::vector<cv::Mat>& inputs, std::vector<cv::Mat>& outputs, int nthreads = 0);
+void skeletonize_batch(const std::vector<std::string>& paths, std::vector<cv::Mat>& outputs, int nthreads = 0);
+
+// Pipeline for a stream of images of the same size. All intermediate buffers
+// are allocated by the constructor, so process() does not touch the heap as
+// long as 'output' is reused between calls. The kernels are fixed, the fused
+// front-end and GuoHallThinning_optimized: the registry, SKELETON_KERNELS and
+// autotuning do not apply. The result is the same as of skeletonize while
+// exact kernels are selected.
+class SkeletonPipeline
+{
+public:
+    explicit SkeletonPipeline(const cv::Size& input_size);
+
+    void process(const cv::Mat& input, cv::Mat& output);
+
+    cv::Size inputSize() const { return input_size_; }
+    cv::Size outputSize() const { return small_size_; }
+
+private:
+    cv::Size input_size_;
+    cv::Size small_size_;
+
+    cv::Mat small_image_;
+    cv::Mat thinned_image_;
+
+    std::vector<uchar> gray_rows_;
+    std::vector<ushort> resize_rows_;
+    std::vector<uchar> thinning_rows_;
+};
+
+// Frame statistics of SkeletonStream
+struct SkeletonStreamStats
+{
+    SkeletonStreamStats();
+
+    int frames;             // frames returned by pop()
+    int queue_depth[4];     // frames waiting before convert, resize, thinning and pop()
+    double latency_ms;      // from push() to pop() of the last frame
+    double mean_latency_ms;
+    double max_latency_ms;
+};
+
+// Pipeline for a video stream. Grayscale conversion, downscale with binarization
+// and thinning run on their own threads connected by bounded lock-free queues,
+// so consecutive frames are processed by different stages at the same time.
+// Stages without work sleep until the next frame arrives.
+// push() blocks while the input queue is full, pop() blocks until the next
+// skeleton is ready and returns false once close() was called and all frames
+// have been returned. Results are the same as of skeletonize.
+// If a stage throws, the stream stops and push(), pop() and close() throw
+// cv::Exception with the stage's message.
+class SkeletonStream
+{
+public:
+    explicit SkeletonStream(const cv::Size& input_size, int queue_capacity = 4);
+    ~SkeletonStream();
+
+    bool push(const cv::Mat& frame);
+    bool pop(cv::Mat& output);
+    void close();
+
+    SkeletonStreamStats stats() const;
+
+    cv::Size inputSize() const;
+    cv::Size outputSize() const;
+
+private:
+    SkeletonStream(const SkeletonStream&);
+    SkeletonStream& operator=(const SkeletonStream&);
+
+    struct Impl;
+    Impl* impl_;
+};
+
+// Synthetic camera frame with dark strokes on a light background,
+// the strokes move slightly with the frame index
+void GenerateSyntheticFrame(cv::Mat& frame, const cv::Size& size, int index);
+
+// Binary document for thinning (foreground is 255): text-like glyphs,
+// rules and filled blobs drawn with the stroke width until about 'density'
+// of the pixels are foreground. The same arguments give the same image.
+void GenerateSyntheticDocument(cv::Mat& binary, const cv::Size& size, int stroke_width, double density,
+                               int seed = 0);
 
 // Internal functions
 void ConvertColor_BGR2GRAY_BT709(const cv::Mat& src, cv::Mat& dst);
 void ImageResize(const cv::Mat &src, cv::Mat &dst, const cv::Size sz);
 void GuoHallThinning(const cv::Mat& src, cv::Mat& dst);
 
+// Fused grayscale conversion, downscale and inverted binarization, the result
+// is the same as of the staged calls in skeletonize
+void ConvertResizeThreshold_fused(const cv::Mat& input, cv::Mat& binary, const cv::Size small_size);
+
 // Optimized versions
 void GuoHallThinning_optimized(const cv::Mat& src, cv::Mat& dst);
+void GuoHallThinning_bitpacked(const cv::Mat& src, cv::Mat& dst);
+void GuoHallThinning_frontier(const cv::Mat& src, cv::Mat& dst);
+void GuoHallThinning_table(const cv::Mat& src, cv::Mat& dst);
+void GuoHallThinning_parallel(const cv::Mat& src, cv::Mat& dst, int nthreads = 0);
 void ImageResize_optimized(const cv::Mat &src, cv::Mat &dst, const cv::Size sz);
+bool ImageResize_3to2_supported(const cv::Size& src, const cv::Size& dst);
+void ImageResize_3to2(const cv::Mat &src, cv::Mat &dst);
 void ConvertColor_BGR2GRAY_BT709_fpt(const cv::Mat& src, cv::Mat& dst);
 void ConvertColor_BGR2GRAY_BT709_simd(const cv::Mat& src, cv::Mat& dst);
+
+// Versions for wider instruction sets, they are called only if both
+// the compiler and the CPU support the corresponding SIMD level
+enum SimdLevel
+{
+    SIMD_NONE = 0,
+    SIMD_SSSE3,
+    SIMD_AVX2,
+    SIMD_AVX512BW
+};
+
+SimdLevel ConvertColor_GetSimdLevel();
+std::string GetCpuModelName();
+void ConvertColor_BGR2GRAY_BT709_avx2(const cv::Mat& src, cv::Mat& dst);
+void ConvertColor_BGR2GRAY_BT709_avx512(const cv::Mat& src, cv::Mat& dst);
+void ConvertColor_BGR2GRAY_BT709_dispatch(const cv::Mat& src, cv::Mat& dst);
@@ -0,0 +1,56 @@
+#include "memory_stats.hpp"
+
+#include "opencv2/core/core.hpp"
+#include "opencv_ptest/include/opencv2/ts/ts.hpp"
+
+#include <stdlib.h>
+#include <new>
+
+// The replaced operator new reports every block to Memory_RecordAlloc,
+// so the allocation counters, the profiler and the harness report
+// include the heap as well as the counted Mat buffers.
+
+// Every block starts with its size, so that the frees are counted too.
+// The header keeps the alignment of malloc.
+static const size_t HEADER_SIZE = 16;
+
+static void* countedAlloc(size_t size)
+{
+    uchar* base = (uchar*)malloc(size + HEADER_SIZE);
+    if (!base)
+        throw std::bad_alloc();
+    *(size_t*)base = size;
+    Memory_RecordAlloc(size);
+    return base + HEADER_SIZE;
+}
+
+static void countedFree(void* ptr)
+{
+    if (!ptr)
+        return;
+    uchar* base = (uchar*)ptr - HEADER_SIZE;
+    Memory_RecordFree(*(size_t*)base);
+    free(base);
+}
+
+void* operator new(size_t size) { return countedAlloc(size); }
+void* operator new[](size_t size) { return countedAlloc(size); }
+void operator delete(void* ptr) throw() { countedFree(ptr); }
+void operator delete[](void* ptr) throw() { countedFree(ptr); }
+
+// Counters of the test cycles for the harness report
+static void readAllocationStats(perf::AllocationStats& stats, bool restart_peak)
+{
+    const MemoryCounters counters = Memory_ReadCounters();
+    stats.allocations = counters.allocations;
+    stats.bytes = counters.bytes;
+    stats.live_bytes = counters.live_bytes;
+    stats.peak_bytes = counters.peak_bytes;
+    if (restart_peak)
+        Memory_BeginPeak();
+}
+
+static struct AllocationStatsRegistration
+{
+    AllocationStatsRegistration() { perf::TestBase::setAllocationStatsHook(readAllocationStats); }
+} registration;
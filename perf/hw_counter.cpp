@@ -0,0 +1,22 @@
+#include "hw_counters.hpp"
+
+#include "opencv2/core/core.hpp"
+#include "opencv_ptest/include/opencv2/ts/ts.hpp"
+
+// Events of the test cycles for the harness report, counted the same way as
+// the profiler stages
+static bool readHardwareCounters(int64 values[perf::HW_EVENT_COUNT])
+{
+    HardwareEvents events;
+    const bool ok = HardwareCounters_Read(events);
+    values[perf::HW_EVENT_CYCLES] = events.cycles;
+    values[perf::HW_EVENT_INSTRUCTIONS] = events.instructions;
+    values[perf::HW_EVENT_CACHE_MISSES] = events.cache_misses;
+    values[perf::HW_EVENT_BRANCH_MISSES] = events.branch_misses;
+    return ok;
+}
+
+static struct HardwareCountersRegistration
+{
+    HardwareCountersRegistration() { perf::TestBase::setHardwareCountersHook(readHardwareCounters); }
+} registration;
@@ -1,6 +1,11 @@
 #include "opencv_ptest/include/opencv2/ts/ts.hpp"
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <stdlib.h>
+
+#include "opencv2/highgui/highgui.hpp"
 
 #include "skeleton_filter.hpp"
 
@@ -14,12 +19,21 @@ using std::tr1::get;
 // Test(s) for the ConvertColor_BGR2GRAY_BT709 function
 //
 
-// PERF_TEST(skeleton, ConvertColor_BGR2GRAY_BT709)
-// {
-//     Mat input = cv::imread("./bin/testdata/sla.png");
-//
-//     // Add code here
-// }
+PERF_TEST(skeleton, ConvertColor_BGR2GRAY_BT709)
+{
+    Mat input = cv::imread("./bin/testdata/sla.png");
+    ASSERT_FALSE(input.empty());
+
+    cv::Mat gray(input.size(), CV_8UC1);
+    declare.in(input).out(gray);
+
+    TEST_CYCLE()
+    {
+        ConvertColor_BGR2GRAY_BT709(input, gray);
+    }
+
+    SANITY_CHECK(gray);
+}
 
 //
 // Test(s) for the ImageResize function
@@ -56,22 +70,333 @@ PERF_TEST_P(Size_Only, ImageResize, testing::Values(MAT_SIZES))
     SANITY_CHECK(dst);
 }
 
+PERF_TEST_P(Size_Only, ImageResize_3to2, testing::Values(::perf::szqHD, ::perf::sz1080p, ::perf::sz2160p))
+{
+    Size sz = GetParam();
+    Size sz_to(sz.width / 1.5, sz.height / 1.5);
+
+    cv::Mat src(sz, CV_8UC1);
+    cv::Mat dst(Size(sz_to), CV_8UC1);
+    cv::Mat gold(Size(sz_to), CV_8UC1);
+    declare.in(src, WARMUP_RNG).out(dst);
+
+    cv::RNG rng(234231412);
+    rng.fill(src, CV_8UC1, 0, 255);
+
+    ASSERT_TRUE(ImageResize_3to2_supported(sz, sz_to));
+    ImageResize(src, gold, sz_to);
+
+    TEST_CYCLE()
+    {
+        ImageResize_3to2(src, dst);
+    }
+
+    cv::Mat diff; cv::absdiff(dst, gold, diff);
+    ASSERT_EQ(0, cv::countNonZero(diff));
+
+    SANITY_CHECK(dst);
+}
+
+PERF_TEST_P(Size_Only, ConvertResizeThreshold_fused, testing::Values(MAT_SIZES))
+{
+    Size sz = GetParam();
+    Size sz_to(sz.width / 1.5, sz.height / 1.5);
+
+    cv::Mat src(sz, CV_8UC3);
+    cv::Mat dst(sz_to, CV_8UC1);
+    declare.in(src, WARMUP_RNG).out(dst);
+
+    cv::theRNG().fill(src, cv::RNG::UNIFORM, 0, 256);
+
+    cv::Mat gray, gold;
+    ConvertColor_BGR2GRAY_BT709(src, gray);
+    if (ImageResize_3to2_supported(sz, sz_to))
+        ImageResize_3to2(gray, gold);
+    else
+        ImageResize(gray, gold, sz_to);
+    cv::threshold(gold, gold, 128, 255, cv::THRESH_BINARY_INV);
+
+    TEST_CYCLE()
+    {
+        ConvertResizeThreshold_fused(src, dst, sz_to);
+    }
+
+    cv::Mat diff; cv::absdiff(dst, gold, diff);
+    ASSERT_EQ(0, cv::countNonZero(diff));
+
+    SANITY_CHECK(dst);
+}
+
 //
 // Test(s) for the skeletonize function
 //
 
-// #define IMAGES testing::Values( std::string("./bin/testdata/sla.png"),\
-//                                 std::string("./bin/testdata/page.png"),\
-//                                 std::string("./bin/testdata/schedule.png") )
-//
-// typedef perf::TestBaseWithParam<std::string> ImageName;
+#define IMAGES testing::Values( std::string("./bin/testdata/sla.png"),\
+                               std::string("./bin/testdata/page.png"),\
+                               std::string("./bin/testdata/schedule.png") )
+
+// Documents are upscaled to the pixel count of a 4K or 8K frame
+enum DocResolution { DOC_NATIVE, DOC_4K, DOC_8K };
+CV_ENUM(DocResolutionType, DOC_NATIVE, DOC_4K, DOC_8K)
+
+typedef std::tr1::tuple<std::string, DocResolutionType> ImageName_Resolution_t;
+typedef perf::TestBaseWithParam<ImageName_Resolution_t> ImageName_Resolution;
+
+static cv::Size documentSize(const cv::Size& native, int resolution)
+{
+    if (resolution == DOC_NATIVE)
+        return native;
+    const double pixels = resolution == DOC_4K ? 3840. * 2160. : 7680. * 4320.;
+    const double scale = std::sqrt(pixels / native.area());
+    // Multiples of 3 keep the exact 3:2 downscale
+    return cv::Size(cvRound(native.width * scale / 3) * 3, cvRound(native.height * scale / 3) * 3);
+}
+
+// Golden skeletons are testdata/golden/<image>_<width>x<height>.png made by
+// the reference kernels, run with SKELETON_WRITE_GOLDEN=1 to create missing ones
+static std::string goldenPath(const std::string& image_path, const cv::Size& sz)
+{
+    const size_t slash = image_path.find_last_of("/\\");
+    const size_t begin = slash == std::string::npos ? 0 : slash + 1;
+    const std::string stem = image_path.substr(begin, image_path.rfind('.') - begin);
+    return image_path.substr(0, begin) + cv::format("golden/%s_%dx%d.png", stem.c_str(), sz.width, sz.height);
+}
+
+// Skeleton made by the baseline kernels of every stage
+static void referenceSkeleton(const cv::Mat& input, cv::Mat& skeleton)
+{
+    KernelInfo selected[KERNEL_STAGE_COUNT];
+    for (int s = 0; s < KERNEL_STAGE_COUNT; s++)
+    {
+        selected[s] = Kernels_Selected((KernelStage)s);
+        Kernels_Select((KernelStage)s, "baseline");
+    }
+    skeletonize(input, skeleton, false);
+    for (int s = 0; s < KERNEL_STAGE_COUNT; s++)
+        Kernels_Select((KernelStage)s, selected[s].name);
+}
+
+PERF_TEST_P(ImageName_Resolution, skeletonize,
+            testing::Combine(IMAGES, DocResolutionType::all()))
+{
+    const std::string path = get<0>(GetParam());
+    const int resolution = get<1>(GetParam());
+
+    Mat document = cv::imread(path);
+    ASSERT_FALSE(document.empty()) << path;
+
+    const cv::Size sz = documentSize(document.size(), resolution);
+    // Nearest neighbour gives the same pixels in any OpenCV build,
+    // so the stored skeletons stay valid for the upscaled documents
+    Mat input;
+    if (sz == document.size())
+        input = document;
+    else
+        cv::resize(document, input, sz, 0, 0, cv::INTER_NEAREST);
+
+    cv::Mat output;
+    declare.in(input).time(resolution == DOC_8K ? 120 : 60);
+
+    // Stage breakdown of the measured calls only
+    const bool profiling = Profiler_IsEnabled();
+    Profiler_Reset();
+    Profiler_SetEnabled(true);
+
+    TEST_CYCLE()
+    {
+        skeletonize(input, output, false);
+    }
+
+    Profiler_SetEnabled(profiling);
+
+    performance_metrics& metrics = calcMetrics();
+    const double total_ms = 1000. * metrics.median / metrics.frequency;
+    std::vector<ProfilerStageStats> stages = Profiler_GetStats();
+    printf("[ STAGE    ] %-16s %10.3f ms\n", "total", total_ms);
+    for (size_t i = 0; i < stages.size(); i++)
+    {
+        if (stages[i].name == "skeletonize")
+            continue;
+        const ProfilerStageStats& s = stages[i];
+        RecordProperty((s.name + "_ms").c_str(), cv::format("%.3f", s.median_ms).c_str());
+        RecordProperty((s.name + "_allocations").c_str(), cv::format("%.1f", (double)s.allocations / s.calls).c_str());
+        RecordProperty((s.name + "_peak_bytes").c_str(), cv::format("%lld", (long long)s.peak_bytes).c_str());
+        printf("[ STAGE    ] %-16s %10.3f ms %6.1f%% %8.1f allocs %10.1f KB peak\n", s.name.c_str(),
+               s.median_ms, 100. * s.median_ms / total_ms, (double)s.allocations / s.calls, s.peak_bytes / 1024.);
+    }
+    Profiler_Reset();
+
+    // Against the stored skeleton
+    const std::string golden_path = goldenPath(path, sz);
+    cv::Mat gold = cv::imread(golden_path, cv::IMREAD_GRAYSCALE);
+    if (gold.empty())
+    {
+        const char* write_golden = getenv("SKELETON_WRITE_GOLDEN");
+        if (!write_golden || std::string(write_golden) != "1")
+            FAIL() << "No golden skeleton " << golden_path;
+
+        referenceSkeleton(input, gold);
+        ASSERT_TRUE(cv::imwrite(golden_path, gold)) << golden_path;
+    }
+    cv::Mat diff; cv::absdiff(output, gold, diff);
+    ASSERT_EQ(0, cv::countNonZero(diff));
+
+    SANITY_CHECK(output);
+}
+
 //
-// PERF_TEST_P(ImageName, skeletonize, IMAGES)
-// {
-//     Mat input = cv::imread(GetParam());
+// Test(s) for the SkeletonPipeline class
 //
-//     // Add code here
-// }
+
+// The fixed kernels of SkeletonPipeline and skeletonize_batch, called one by one;
+// skeletonize would use whatever the registry or autotuning selected
+static void fixedKernelsSkeleton(const cv::Mat& input, cv::Mat& output)
+{
+    const Size small_size(input.cols / 1.5, input.rows / 1.5);
+    cv::Mat binary; ConvertResizeThreshold_fused(input, binary, small_size);
+    cv::Mat thinned; GuoHallThinning_optimized(binary, thinned);
+    output = 255 - thinned;
+}
+
+PERF_TEST_P(Size_Only, skeletonize_free, testing::Values(MAT_SIZES))
+{
+    Size sz = GetParam();
+
+    cv::Mat input(sz, CV_8UC3);
+    declare.in(input, WARMUP_RNG);
+    declare.time(40);
+
+    cv::Mat output;
+    skeletonize(input, output, false);
+
+    // operator new and the counted Mat buffers
+    int64 allocations = Memory_ReadCounters().allocations;
+    skeletonize(input, output, false);
+    allocations = Memory_ReadCounters().allocations - allocations;
+    RecordProperty("allocations_per_call", (int)allocations);
+
+    TEST_CYCLE()
+    {
+        skeletonize(input, output, false);
+    }
+
+    SANITY_CHECK(output);
+}
+
+PERF_TEST_P(Size_Only, SkeletonPipeline, testing::Values(MAT_SIZES))
+{
+    Size sz = GetParam();
+
+    cv::Mat input(sz, CV_8UC3);
+    declare.in(input, WARMUP_RNG);
+    declare.time(40);
+
+    cv::Mat gold; fixedKernelsSkeleton(input, gold);
+
+    SkeletonPipeline pipeline(sz);
+    cv::Mat output;
+    output.allocator = Memory_MatAllocator();
+    pipeline.process(input, output);
+
+    // Steady state: the output buffer is already allocated. The pipeline's
+    // own images use the counting allocator too, so a Mat reallocated
+    // inside process() shows up here as well as operator new.
+    int64 allocations = Memory_ReadCounters().allocations;
+    pipeline.process(input, output);
+    allocations = Memory_ReadCounters().allocations - allocations;
+    RecordProperty("allocations_per_call", (int)allocations);
+    EXPECT_EQ(0, allocations);
+
+    TEST_CYCLE()
+    {
+        pipeline.process(input, output);
+    }
+
+    cv::Mat diff; cv::absdiff(output, gold, diff);
+    ASSERT_EQ(0, cv::countNonZero(diff));
+
+    SANITY_CHECK(output);
+}
+
+// Large scans with and without the pool of intermediate buffers
+typedef std::tr1::tuple<Size, bool> Size_Pooled_t;
+typedef perf::TestBaseWithParam<Size_Pooled_t> Size_Pooled;
+
+PERF_TEST_P(Size_Pooled, skeletonize_pooled,
+            testing::Combine(testing::Values(::perf::sz1080p, ::perf::sz2160p), testing::Bool()))
+{
+    Size sz = get<0>(GetParam());
+    bool pooled = get<1>(GetParam());
+
+    cv::Mat input(sz, CV_8UC3);
+    declare.in(input, WARMUP_RNG);
+    declare.time(60);
+
+    const bool was_enabled = MatPool_IsEnabled();
+    MatPool_SetEnabled(pooled);
+    MatPool_Trim();
+
+    cv::Mat output;
+    const MatPoolStats before = MatPool_GetStats();
+    TEST_CYCLE()
+    {
+        skeletonize(input, output, false);
+    }
+    const MatPoolStats after = MatPool_GetStats();
+
+    MatPool_SetEnabled(was_enabled);
+    MatPool_Trim();
+
+    if (pooled)
+    {
+        RecordProperty("pool_hits", (int)(after.hits - before.hits));
+        RecordProperty("pool_misses", (int)(after.misses - before.misses));
+    }
+
+    SANITY_CHECK(output);
+}
+
+// Frames in flight between push() and pop(), the same as the queue capacity
+#define STREAM_WINDOW 4
+#define STREAM_FRAMES 32
+
+PERF_TEST_P(Size_Only, SkeletonStream, testing::Values(MAT_SIZES))
+{
+    Size sz = GetParam();
+    declare.time(60);
+
+    std::vector<cv::Mat> frames(STREAM_FRAMES);
+    for (int i = 0; i < STREAM_FRAMES; i++)
+        GenerateSyntheticFrame(frames[i], sz, i);
+
+    SkeletonStream stream(sz, STREAM_WINDOW);
+    cv::Mat output;
+
+    TEST_CYCLE()
+    {
+        for (int i = 0; i < STREAM_FRAMES; i++)
+        {
+            stream.push(frames[i]);
+            if (i >= STREAM_WINDOW)
+                stream.pop(output);
+        }
+        for (int i = 0; i < STREAM_WINDOW; i++)
+            stream.pop(output);
+    }
+
+    performance_metrics& metrics = calcMetrics();
+    double frames_per_sec = STREAM_FRAMES * metrics.frequency / metrics.median;
+    SkeletonStreamStats stats = stream.stats();
+    RecordProperty("frames_per_sec", cv::format("%.2f", frames_per_sec).c_str());
+    RecordProperty("mean_latency_ms", cv::format("%.2f", stats.mean_latency_ms).c_str());
+    RecordProperty("max_latency_ms", cv::format("%.2f", stats.max_latency_ms).c_str());
+
+    cv::Mat gold; skeletonize(frames[STREAM_FRAMES - 1], gold, false);
+    cv::Mat diff; cv::absdiff(output, gold, diff);
+    ASSERT_EQ(0, cv::countNonZero(diff));
+
+    SANITY_CHECK_NOTHING();
+}
 
 //
 // Test(s) for the Thinning function
@@ -103,6 +428,305 @@ PERF_TEST_P(Size_Only, Thinning, testing::Values(MAT_SIZES))
     SANITY_CHECK(image);
 }
 
+PERF_TEST_P(Size_Only, Thinning_bitpacked, testing::Values(MAT_SIZES))
+{
+    Size sz = GetParam();
+
+    cv::Mat image(sz, CV_8UC1);
+    declare.in(image, WARMUP_RNG).out(image);
+    declare.time(40);
+
+    cv::RNG rng(234231412);
+    rng.fill(image, CV_8UC1, 0, 255);
+    cv::threshold(image, image, 240, 255, cv::THRESH_BINARY_INV);
+
+    cv::Mat gold; GuoHallThinning(image, gold);
+
+    cv::Mat thinned_image;
+    TEST_CYCLE()
+    {
+        GuoHallThinning_bitpacked(image, thinned_image);
+    }
+
+    cv::Mat diff; cv::absdiff(thinned_image, gold, diff);
+    ASSERT_EQ(0, cv::countNonZero(diff));
+
+    SANITY_CHECK(image);
+}
+
+PERF_TEST_P(Size_Only, Thinning_frontier, testing::Values(MAT_SIZES))
+{
+    Size sz = GetParam();
+
+    cv::Mat image(sz, CV_8UC1);
+    declare.in(image, WARMUP_RNG).out(image);
+    declare.time(40);
+
+    cv::RNG rng(234231412);
+    rng.fill(image, CV_8UC1, 0, 255);
+    cv::threshold(image, image, 240, 255, cv::THRESH_BINARY_INV);
+
+    cv::Mat gold; GuoHallThinning(image, gold);
+
+    cv::Mat thinned_image;
+    TEST_CYCLE()
+    {
+        GuoHallThinning_frontier(image, thinned_image);
+    }
+
+    cv::Mat diff; cv::absdiff(thinned_image, gold, diff);
+    ASSERT_EQ(0, cv::countNonZero(diff));
+
+    SANITY_CHECK(image);
+}
+
+PERF_TEST_P(Size_Only, Thinning_table, testing::Values(MAT_SIZES))
+{
+    Size sz = GetParam();
+
+    cv::Mat image(sz, CV_8UC1);
+    declare.in(image, WARMUP_RNG).out(image);
+    declare.time(40);
+
+    cv::RNG rng(234231412);
+    rng.fill(image, CV_8UC1, 0, 255);
+    cv::threshold(image, image, 240, 255, cv::THRESH_BINARY_INV);
+
+    cv::Mat gold; GuoHallThinning(image, gold);
+
+    cv::Mat thinned_image;
+    TEST_CYCLE()
+    {
+        GuoHallThinning_table(image, thinned_image);
+    }
+
+    cv::Mat diff; cv::absdiff(thinned_image, gold, diff);
+    ASSERT_EQ(0, cv::countNonZero(diff));
+
+    SANITY_CHECK(image);
+}
+
+// Thinning takes about half the thickest stroke in iterations, so its cost
+// depends on the content as much as on the image size
+#define STROKE_WIDTHS      2, 8, 24
+#define DENSITIES          0.05, 0.2, 0.4
+#define THINNING_KERNELS   std::string("baseline"), std::string("optimized"), std::string("bitpacked"),\
+                           std::string("frontier"), std::string("table")
+
+typedef std::tr1::tuple<Size, int, double, std::string> Size_Width_Density_Kernel_t;
+typedef perf::TestBaseWithParam<Size_Width_Density_Kernel_t> Size_Width_Density_Kernel;
+
+PERF_TEST_P(Size_Width_Density_Kernel, Thinning_content,
+            testing::Combine(testing::Values(::perf::szVGA, ::perf::sz1080p),
+                             testing::Values(STROKE_WIDTHS),
+                             testing::Values(DENSITIES),
+                             testing::Values(THINNING_KERNELS)))
+{
+    Size sz = get<0>(GetParam());
+    int stroke_width = get<1>(GetParam());
+    double density = get<2>(GetParam());
+    std::string name = get<3>(GetParam());
+
+    ThinningKernel thinning = 0;
+    std::vector<KernelInfo> kernels = Kernels_List(KERNEL_THINNING);
+    for (size_t i = 0; i < kernels.size(); i++)
+    {
+        if (kernels[i].name == name)
+            thinning = kernels[i].thinning;
+    }
+    ASSERT_TRUE(thinning != 0) << name;
+
+    cv::Mat image;
+    GenerateSyntheticDocument(image, sz, stroke_width, density);
+    declare.in(image).time(60);
+
+    double foreground = 100. * cv::countNonZero(image) / image.total();
+    RecordProperty("foreground_percent", cv::format("%.1f", foreground).c_str());
+
+    cv::Mat thinned_image;
+    TEST_CYCLE()
+    {
+        thinning(image, thinned_image);
+    }
+
+    performance_metrics& metrics = calcMetrics();
+    double ns_per_pixel = 1e9 * metrics.median / metrics.frequency / image.total();
+    RecordProperty("ns_per_pixel", cv::format("%.2f", ns_per_pixel).c_str());
+
+    cv::Mat gold; GuoHallThinning(image, gold);
+    cv::Mat diff; cv::absdiff(thinned_image, gold, diff);
+    ASSERT_EQ(0, cv::countNonZero(diff));
+
+    SANITY_CHECK(image);
+}
+
+#define THREAD_COUNTS 1, 2, 4, 8, 16, 32
+
+// Thread scaling: every point times the same work on one thread as well and
+// reports its speedup and parallel efficiency against that, so any single
+// point can be run on its own. A point below SKELETON_MIN_EFFICIENCY (0..1,
+// SCALING_MIN_EFFICIENCY by default) is reported with a warning.
+#define SCALING_RUNS 3
+#define SCALING_MIN_EFFICIENCY 0.5
+
+typedef void (*ScalingWorkload)(void* arg, int threads);
+
+// Median of a few runs after a warm-up
+static double singleThreadSeconds(ScalingWorkload workload, void* arg)
+{
+    workload(arg, 1);
+
+    std::vector<double> runs(SCALING_RUNS);
+    for (int i = 0; i < SCALING_RUNS; i++)
+    {
+        int64 start = cv::getTickCount();
+        workload(arg, 1);
+        runs[i] = (cv::getTickCount() - start) / cv::getTickFrequency();
+    }
+    std::sort(runs.begin(), runs.end());
+    return runs[SCALING_RUNS / 2];
+}
+
+static void recordScaling(int threads, double seconds, double single_thread_seconds)
+{
+    const char* env = getenv("SKELETON_MIN_EFFICIENCY");
+    const double min_efficiency = env ? atof(env) : SCALING_MIN_EFFICIENCY;
+
+    const double speedup = single_thread_seconds / seconds;
+    const double efficiency = speedup / threads;
+    ::testing::Test::RecordProperty("speedup", cv::format("%.2f", speedup).c_str());
+    ::testing::Test::RecordProperty("efficiency", cv::format("%.2f", efficiency).c_str());
+    printf("[ SCALING  ] %d threads: speedup %.2f, efficiency %.0f%%\n", threads, speedup, 100 * efficiency);
+    if (efficiency < min_efficiency)
+    {
+        ::testing::Test::RecordProperty("efficiency_warning", "1");
+        printf("[ WARNING  ] efficiency %.0f%% is below the limit of %.0f%%\n", 100 * efficiency, 100 * min_efficiency);
+    }
+    fflush(stdout);
+}
+
+// The kernels limit their workers through nstripes, so they never get more
+// threads than the OpenCV pool has; such points would only repeat its size
+static bool threadsAvailable(int threads)
+{
+    return threads <= cv::getNumThreads();
+}
+
+struct ThinningWorkload
+{
+    const cv::Mat* image;
+    cv::Mat thinned_image;
+};
+
+static void runThinningWorkload(void* arg, int threads)
+{
+    ThinningWorkload* w = (ThinningWorkload*)arg;
+    GuoHallThinning_parallel(*w->image, w->thinned_image, threads);
+}
+
+typedef std::tr1::tuple<Size, int> Size_Threads_t;
+typedef perf::TestBaseWithParam<Size_Threads_t> Size_Threads;
+
+PERF_TEST_P(Size_Threads, Thinning_parallel,
+            testing::Combine(testing::Values(MAT_SIZES), testing::Values(THREAD_COUNTS)))
+{
+    Size sz = get<0>(GetParam());
+    int threads = get<1>(GetParam());
+
+    if (!threadsAvailable(threads))
+        throw PerfSkipTestException();
+
+    cv::Mat image(sz, CV_8UC1);
+    declare.in(image, WARMUP_RNG).out(image);
+    declare.time(40);
+
+    cv::RNG rng(234231412);
+    rng.fill(image, CV_8UC1, 0, 255);
+    cv::threshold(image, image, 240, 255, cv::THRESH_BINARY_INV);
+
+    cv::Mat gold; GuoHallThinning(image, gold);
+
+    ThinningWorkload single = { &image, cv::Mat() };
+    const double single_thread_seconds = singleThreadSeconds(runThinningWorkload, &single);
+
+    cv::Mat thinned_image;
+    TEST_CYCLE()
+    {
+        GuoHallThinning_parallel(image, thinned_image, threads);
+    }
+
+    performance_metrics& metrics = calcMetrics();
+    recordScaling(threads, metrics.median / metrics.frequency, single_thread_seconds);
+
+    cv::Mat diff; cv::absdiff(thinned_image, gold, diff);
+    ASSERT_EQ(0, cv::countNonZero(diff));
+
+    SANITY_CHECK(image);
+}
+
+// Each test image is repeated to give every worker several images to process
+#define BATCH_REPEATS 4
+
+typedef perf::TestBaseWithParam<int> Threads_Only;
+
+struct BatchWorkload
+{
+    const std::vector<cv::Mat>* inputs;
+    std::vector<cv::Mat> outputs;
+};
+
+static void runBatchWorkload(void* arg, int threads)
+{
+    BatchWorkload* w = (BatchWorkload*)arg;
+    skeletonize_batch(*w->inputs, w->outputs, threads);
+}
+
+PERF_TEST_P(Threads_Only, skeletonize_batch, testing::Values(THREAD_COUNTS))
+{
+    int threads = GetParam();
+
+    if (!threadsAvailable(threads))
+        throw PerfSkipTestException();
+
+    const char* names[] = { "./bin/testdata/sla.png", "./bin/testdata/page.png", "./bin/testdata/schedule.png" };
+
+    std::vector<cv::Mat> inputs;
+    for (int r = 0; r < BATCH_REPEATS; r++)
+    {
+        for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+        {
+            cv::Mat input = cv::imread(names[i]);
+            ASSERT_FALSE(input.empty()) << names[i];
+            inputs.push_back(input);
+        }
+    }
+    declare.time(60);
+
+    BatchWorkload single = { &inputs, std::vector<cv::Mat>() };
+    const double single_thread_seconds = singleThreadSeconds(runBatchWorkload, &single);
+
+    std::vector<cv::Mat> outputs;
+    TEST_CYCLE()
+    {
+        skeletonize_batch(inputs, outputs, threads);
+    }
+
+    performance_metrics& metrics = calcMetrics();
+    double images_per_sec = inputs.size() * metrics.frequency / metrics.median;
+    RecordProperty("images_per_sec", cv::format("%.2f", images_per_sec).c_str());
+    recordScaling(threads, metrics.median / metrics.frequency, single_thread_seconds);
+
+    ASSERT_EQ(inputs.size(), outputs.size());
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        cv::Mat gold; fixedKernelsSkeleton(inputs[i], gold);
+        cv::Mat diff; cv::absdiff(outputs[i], gold, diff);
+        ASSERT_EQ(0, cv::countNonZero(diff));
+    }
+
+    SANITY_CHECK_NOTHING();
+}
+
 PERF_TEST_P(Size_Only, ConvertColor_fpt, testing::Values(MAT_SIZES))
 {
     Size sz = GetParam();
@@ -157,6 +781,49 @@ PERF_TEST_P(Size_Only, ConvertColor_simd, testing::Values(MAT_SIZES))
     SANITY_CHECK(dst);
 }
 
+CV_ENUM(SimdLevelType, SIMD_SSSE3, SIMD_AVX2, SIMD_AVX512BW)
+
+typedef std::tr1::tuple<Size, SimdLevelType> Size_SimdLevel_t;
+typedef perf::TestBaseWithParam<Size_SimdLevel_t> Size_SimdLevel;
+
+PERF_TEST_P(Size_SimdLevel, ConvertColor_isa,
+            testing::Combine(testing::Values(MAT_SIZES), SimdLevelType::all()))
+{
+    Size sz = get<0>(GetParam());
+    int level = get<1>(GetParam());
+
+    if (level > ConvertColor_GetSimdLevel())
+        throw PerfSkipTestException();
+
+    void (*convert)(const cv::Mat&, cv::Mat&) =
+        level == SIMD_AVX512BW ? ConvertColor_BGR2GRAY_BT709_avx512 :
+        level == SIMD_AVX2     ? ConvertColor_BGR2GRAY_BT709_avx2 :
+                                 ConvertColor_BGR2GRAY_BT709_simd;
+
+    cv::Mat src(sz, CV_8UC3);
+    cv::Mat dst(sz, CV_8UC1);
+    cv::Mat gold(sz, CV_8UC1);
+    declare.in(src, WARMUP_RNG).out(dst);
+
+    cv::theRNG().fill(src, cv::RNG::UNIFORM, 0, 256);
+
+    ConvertColor_BGR2GRAY_BT709(src, gold);
+
+    TEST_CYCLE()
+    {
+        convert(src, dst);
+    }
+
+    cv::Mat diff; cv::absdiff(dst, gold, diff);
+    cv::Mat diff1; cv::threshold(diff, diff1, 1, 0, cv::THRESH_TOZERO);
+    ASSERT_EQ(0, cv::countNonZero(diff1));
+
+    // Even if it is 1-off error there should be no more than 20% of such pixels
+    ASSERT_LT(cv::countNonZero(diff), sz.width*sz.height*20/100);
+
+    SANITY_CHECK(dst);
+}
+
 // Accuracy test by the way...
 TEST(CompleteColorSpace, ConvertColor_fpt)
 {
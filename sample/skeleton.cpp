@@ -12,6 +12,9 @@ using namespace cv;
 const char* options =
      "{ i | image |       | image to process         }"
      "{ s | save  | false | save intermediate images }"
+     "{ f | fused | false | use fused front-end       }"
+     "{ p | profile | false | print per-stage timings }"
+     "{ k | kernels |       | kernels of the stages, e.g. thinning=bitpacked }"
      "{ h | help  | false | print help               }";
 
 int main(int argc, const char** argv)
@@ -45,9 +48,26 @@ int main(int argc, const char** argv)
     else
         cout << "Image saving is DISABLED" << endl;
 
+    // Check if the fused front-end is requested
+    bool fused = parser.get<bool>("fused");
+
+    // Select stage implementations
+    string kernels = parser.get<string>("kernels");
+    if (!kernels.empty() && !Kernels_Configure(kernels))
+        cout << "Warning: unknown or unsupported kernels in " << kernels << endl;
+    for (int stage = 0; stage < KERNEL_STAGE_COUNT; stage++)
+        cout << "Kernel of " << Kernels_StageName((KernelStage)stage) << ": "
+             << Kernels_Selected((KernelStage)stage).name << endl;
+
+    // Per-stage timings are printed at exit
+    if (parser.get<bool>("profile"))
+        Profiler_SetEnabled(true);
+
     // Process image
     Mat output;
-    skeletonize(input, output, save_images);
+    skeletonize(input, output, save_images, fused);
+    if (save_images && ImageWriter_Flush() > 0)
+        cout << "Warning: failed to save some of the intermediate images" << endl;
 
     // Show output image
     imshow("Output image", output);
@@ -0,0 +1,336 @@
+#include "kernel_registry.hpp"
+#include "skeleton_filter.hpp"
+
+#include "opencv2/imgproc/imgproc.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined _WIN32
+#  include <windows.h>
+#  include <process.h>
+#else
+#  include <unistd.h>
+#endif
+
+#include <fstream>
+#include <sstream>
+#include <map>
+
+// Each kernel runs until it has been measured this many times and for at least
+// this long, the best run is taken
+static const int    TUNE_MIN_RUNS = 3;
+static const double TUNE_MIN_SECONDS = 0.1;
+
+static void runKernel(const KernelInfo& kernel, const cv::Mat& src, cv::Mat& dst, const cv::Size& dst_size)
+{
+    switch (kernel.stage)
+    {
+    case KERNEL_CONVERTCOLOR: kernel.convert(src, dst); break;
+    case KERNEL_RESIZE:       kernel.resize(src, dst, dst_size); break;
+    default:                  kernel.thinning(src, dst); break;
+    }
+}
+
+// Best of the measured runs. A kernel which is clearly slower than 'limit'
+// already on the first run is not measured any further.
+static double bestTime(const KernelInfo& kernel, const cv::Mat& src, cv::Mat& dst, const cv::Size& dst_size,
+                       double limit)
+{
+    double best = 0;
+    double total = 0;
+    for (int run = 0; run <= TUNE_MIN_RUNS || total < TUNE_MIN_SECONDS; run++)
+    {
+        const int64 start = cv::getTickCount();
+        runKernel(kernel, src, dst, dst_size);
+        const double seconds = (cv::getTickCount() - start) / cv::getTickFrequency();
+
+        // The first run warms up caches and lazily allocated buffers
+        if (run == 0)
+        {
+            if (limit > 0 && seconds > 2 * limit)
+                return seconds;
+            continue;
+        }
+        best = (run == 1) ? seconds : std::min(best, seconds);
+        total += seconds;
+    }
+    return best;
+}
+
+static int maxDifference(const cv::Mat& a, const cv::Mat& b)
+{
+    if (a.size() != b.size() || a.type() != b.type())
+        return 256;
+    cv::Mat diff;
+    cv::absdiff(a, b, diff);
+    double max_diff;
+    cv::minMaxLoc(diff, 0, &max_diff);
+    return (int)max_diff;
+}
+
+// What the rest of the pipeline makes of a stage's result: the binary image
+// thresholded from it, with the reference kernels for the stages between.
+// A difference of 1 in gray level flips the pixels at the threshold, so the
+// front-end kernels are compared on this image, thinning on its own result.
+static void pipelineResult(KernelStage stage, const cv::Mat& dst, const cv::Size& small_size, cv::Mat& result)
+{
+    cv::Mat small_image;
+    switch (stage)
+    {
+    case KERNEL_CONVERTCOLOR: ImageResize(dst, small_image, small_size); break;
+    case KERNEL_RESIZE:       small_image = dst; break;
+    default:                  result = dst; return;
+    }
+    cv::threshold(small_image, result, 128, 255, cv::THRESH_BINARY_INV);
+}
+
+// Fastest supported kernel which gives the pipeline the same result as the stage's reference
+static std::string tuneStage(KernelStage stage, const cv::Mat& src, const cv::Size& dst_size)
+{
+    std::vector<KernelInfo> kernels = Kernels_List(stage);
+
+    std::string best_name = Kernels_Selected(stage).name;
+    double best_time = -1;
+
+    // The reference is the slowest one, a single run is enough for it
+    cv::Mat reference;
+    for (size_t i = 0; i < kernels.size(); i++)
+    {
+        if (kernels[i].name != "baseline")
+            continue;
+        const int64 start = cv::getTickCount();
+        cv::Mat dst;
+        runKernel(kernels[i], src, dst, dst_size);
+        best_time = (cv::getTickCount() - start) / cv::getTickFrequency();
+        best_name = kernels[i].name;
+        pipelineResult(stage, dst, dst_size, reference);
+    }
+
+    for (size_t i = 0; i < kernels.size(); i++)
+    {
+        if (kernels[i].name == "baseline" || !Kernels_Supported(kernels[i]))
+            continue;
+
+        cv::Mat dst;
+        const double time = bestTime(kernels[i], src, dst, dst_size, best_time);
+        if (!reference.empty())
+        {
+            cv::Mat result;
+            pipelineResult(stage, dst, dst_size, result);
+            if (maxDifference(reference, result) != 0)
+                continue;
+        }
+
+        if (best_time < 0 || time < best_time)
+        {
+            best_time = time;
+            best_name = kernels[i].name;
+        }
+    }
+    return best_name;
+}
+
+//
+// Cache of the decisions, one "stage width height kernel cpu-model" line each
+//
+
+struct TuneEntry
+{
+    std::string stage;
+    cv::Size size;
+    std::string kernel;
+    std::string cpu;
+};
+
+static std::vector<TuneEntry> loadCache(const std::string& path)
+{
+    std::vector<TuneEntry> entries;
+    std::ifstream file(path.c_str());
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::istringstream fields(line);
+        TuneEntry entry;
+        if (!(fields >> entry.stage >> entry.size.width >> entry.size.height >> entry.kernel))
+            continue;
+        std::getline(fields >> std::ws, entry.cpu);
+        entries.push_back(entry);
+    }
+    return entries;
+}
+
+// The file is written under a name of this process and then renamed over
+// the cache, so other processes never read a half-written one
+static bool saveCache(const std::string& path, const std::vector<TuneEntry>& entries)
+{
+#if defined _WIN32
+    const int pid = _getpid();
+#else
+    const int pid = (int)getpid();
+#endif
+    const std::string temp_path = cv::format("%s.%d.tmp", path.c_str(), pid);
+    {
+        std::ofstream file(temp_path.c_str());
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+            const TuneEntry& e = entries[i];
+            file << e.stage << " " << e.size.width << " " << e.size.height << " " << e.kernel << " " << e.cpu << "\n";
+        }
+        file.close();
+        if (!file.good())
+        {
+            remove(temp_path.c_str());
+            return false;
+        }
+    }
+
+#if defined _WIN32
+    const bool renamed = MoveFileExA(temp_path.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    const bool renamed = rename(temp_path.c_str(), path.c_str()) == 0;
+#endif
+    if (!renamed)
+        remove(temp_path.c_str());
+    return renamed;
+}
+
+static int findEntry(const std::vector<TuneEntry>& entries, const std::string& stage,
+                     const cv::Size& size, const std::string& cpu)
+{
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        if (entries[i].stage == stage && entries[i].size == size && entries[i].cpu == cpu)
+            return (int)i;
+    }
+    return -1;
+}
+
+std::string Kernels_AutotuneCachePath()
+{
+    const char* env = getenv("SKELETON_TUNE_CACHE");
+    return env && *env ? env : "skeleton_tune.cache";
+}
+
+bool Kernels_AutotuneEnabled()
+{
+    static const char* env = getenv("SKELETON_AUTOTUNE");
+    return env && std::string(env) == "1";
+}
+
+// Registered kernel with the name, if the CPU and the build support it
+static bool findKernel(KernelStage stage, const std::string& name, KernelInfo& kernel)
+{
+    const std::vector<KernelInfo> kernels = Kernels_List(stage);
+    for (size_t i = 0; i < kernels.size(); i++)
+    {
+        if (kernels[i].name == name && Kernels_Supported(kernels[i]))
+        {
+            kernel = kernels[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+// Decisions made by this process for every cache file, so repeated calls
+// do not read the file
+static std::map<std::string, std::vector<TuneEntry> > session_caches;
+static cv::Mutex tune_mutex;
+
+// The kernels for the size are returned, the selection of the registry is not touched
+static int tune(const cv::Size& input_size, const std::string& cache_path, KernelInfo tuned[KERNEL_STAGE_COUNT])
+{
+    CV_Assert(input_size.width > 0 && input_size.height > 0);
+    cv::AutoLock lock(tune_mutex);
+
+    // Sizes of the images every stage gets in the pipeline
+    const cv::Size small_size(input_size.width / 1.5, input_size.height / 1.5);
+    const cv::Size stage_sizes[KERNEL_STAGE_COUNT] = { input_size, input_size, small_size };
+
+    const std::string path = cache_path.empty() ? Kernels_AutotuneCachePath() : cache_path;
+    const std::string cpu = GetCpuModelName();
+    std::vector<TuneEntry>& session_entries = session_caches[path];
+
+    bool known = true;
+    for (int s = 0; s < KERNEL_STAGE_COUNT && known; s++)
+    {
+        const int index = findEntry(session_entries, Kernels_StageName((KernelStage)s), stage_sizes[s], cpu);
+        known = index >= 0 && findKernel((KernelStage)s, session_entries[index].kernel, tuned[s]);
+    }
+    if (known)
+        return 0;
+
+    std::vector<TuneEntry> entries = loadCache(path);
+
+    // Representative images of every stage, generated only if something is measured
+    cv::Mat input, gray, binary;
+    const cv::Mat* stage_inputs[KERNEL_STAGE_COUNT] = { &input, &gray, &binary };
+
+    int measured = 0;
+    for (int s = 0; s < KERNEL_STAGE_COUNT; s++)
+    {
+        const KernelStage stage = (KernelStage)s;
+        const std::string name = Kernels_StageName(stage);
+
+        // A cached kernel may be gone or unsupported after a rebuild
+        const int index = findEntry(entries, name, stage_sizes[s], cpu);
+        if (index >= 0 && findKernel(stage, entries[index].kernel, tuned[s]))
+            continue;
+
+        if (input.empty())
+        {
+            GenerateSyntheticFrame(input, input_size, 0);
+            ConvertColor_BGR2GRAY_BT709(input, gray);
+            ImageResize(gray, binary, small_size);
+            cv::threshold(binary, binary, 128, 255, cv::THRESH_BINARY_INV);
+        }
+
+        TuneEntry entry;
+        entry.stage = name;
+        entry.size = stage_sizes[s];
+        entry.kernel = tuneStage(stage, *stage_inputs[s], small_size);
+        entry.cpu = cpu;
+        if (!findKernel(stage, entry.kernel, tuned[s]))
+            tuned[s] = Kernels_Selected(stage);
+
+        if (index >= 0)
+            entries[index] = entry;
+        else
+            entries.push_back(entry);
+        measured++;
+    }
+
+    for (int s = 0; s < KERNEL_STAGE_COUNT; s++)
+    {
+        const int index = findEntry(entries, Kernels_StageName((KernelStage)s), stage_sizes[s], cpu);
+        const int session_index = findEntry(session_entries, entries[index].stage, entries[index].size, cpu);
+        if (session_index >= 0)
+            session_entries[session_index] = entries[index];
+        else
+            session_entries.push_back(entries[index]);
+    }
+
+    if (measured > 0 && !saveCache(path, entries))
+        fprintf(stderr, "Warning: failed to write the autotuning cache %s\n", path.c_str());
+    return measured;
+}
+
+int Kernels_Autotune(const cv::Size& input_size, const std::string& cache_path)
+{
+    KernelInfo tuned[KERNEL_STAGE_COUNT];
+    const int measured = tune(input_size, cache_path, tuned);
+    for (int s = 0; s < KERNEL_STAGE_COUNT; s++)
+        Kernels_Select((KernelStage)s, tuned[s].name);
+    return measured;
+}
+
+int Kernels_Autotune(const cv::Size& input_size, KernelSet& kernels, const std::string& cache_path)
+{
+    KernelInfo tuned[KERNEL_STAGE_COUNT];
+    const int measured = tune(input_size, cache_path, tuned);
+    kernels.convert = tuned[KERNEL_CONVERTCOLOR].convert;
+    kernels.resize = tuned[KERNEL_RESIZE].resize;
+    kernels.thinning = tuned[KERNEL_THINNING].thinning;
+    return measured;
+}
@@ -1,12 +1,21 @@
 #include "skeleton_filter.hpp"
+#include "row_kernels.hpp"
+#include "convertcolor_isa.hpp"
 
 #if defined __SSSE3__  || (defined _MSC_VER && _MSC_VER >= 1500)
 #  include "tmmintrin.h"
 #  define HAVE_SSE
 #endif
 
+#if defined _MSC_VER
+#  include <intrin.h>
+#elif defined __GNUC__ && (defined __i386__ || defined __x86_64__)
+#  include <cpuid.h>
+#endif
+
 #include <string>
 #include <sstream>
+#include <string.h>
 
 // Function for debug prints
 template <typename T>
@@ -31,24 +40,28 @@ std::string __m128i_toString(const __m128i var)
     return sstr.str();
 }
 
+void ConvertColor_BGR2GRAY_BT709_row(const uchar* src, uchar* dst, int width)
+{
+    const int bidx = 0;
+
+    const cv::Vec3b *psrc = (const cv::Vec3b*)src;
+
+    for (int x = 0; x < width; x++)
+    {
+        float color = 0.2126 * psrc[x][2-bidx] + 0.7152 * psrc[x][1] + 0.0722 * psrc[x][bidx];
+        dst[x] = (int)(color + 0.5);
+    }
+}
+
 void ConvertColor_BGR2GRAY_BT709(const cv::Mat& src, cv::Mat& dst)
 {
     CV_Assert(CV_8UC3 == src.type());
     cv::Size sz = src.size();
     dst.create(sz, CV_8UC1);
 
-    const int bidx = 0;
-
     for (int y = 0; y < sz.height; y++)
     {
-        const cv::Vec3b *psrc = src.ptr<cv::Vec3b>(y);
-        uchar *pdst = dst.ptr<uchar>(y);
-
-        for (int x = 0; x < sz.width; x++)
-        {
-            float color = 0.2126 * psrc[x][2-bidx] + 0.7152 * psrc[x][1] + 0.0722 * psrc[x][bidx];
-            pdst[x] = (int)(color + 0.5);
-        }
+        ConvertColor_BGR2GRAY_BT709_row(src.ptr<uchar>(y), dst.ptr<uchar>(y), sz.width);
     }
 }
 
@@ -84,12 +97,12 @@ void ConvertColor_BGR2GRAY_BT709_simd(const cv::Mat& src, cv::Mat& dst)
     dst.create(sz, CV_8UC1);
 
 #ifdef HAVE_SSE
-    // __m128i ssse3_blue_indices_0  = _mm_set_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 15, 12,  9,  6,  3,  0);
-    // __m128i ssse3_blue_indices_1  = _mm_set_epi8(-1, -1, -1, -1, -1, 14, 11,  8,  5,  2, -1, -1, -1, -1, -1, -1);
-    // __m128i ssse3_blue_indices_2  = _mm_set_epi8(13, 10,  7,  4,  1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
-    // __m128i ssse3_green_indices_0 = _mm_set_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 13, 10,  7,  4,  1);
-    // __m128i ssse3_green_indices_1 = _mm_set_epi8(-1, -1, -1, -1, -1, 15, 12,  9,  6,  3,  0, -1, -1, -1, -1, -1);
-    // __m128i ssse3_green_indices_2 = _mm_set_epi8(14, 11,  8,  5,  2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    __m128i ssse3_blue_indices_0  = _mm_set_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 15, 12,  9,  6,  3,  0);
+    __m128i ssse3_blue_indices_1  = _mm_set_epi8(-1, -1, -1, -1, -1, 14, 11,  8,  5,  2, -1, -1, -1, -1, -1, -1);
+    __m128i ssse3_blue_indices_2  = _mm_set_epi8(13, 10,  7,  4,  1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    __m128i ssse3_green_indices_0 = _mm_set_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 13, 10,  7,  4,  1);
+    __m128i ssse3_green_indices_1 = _mm_set_epi8(-1, -1, -1, -1, -1, 15, 12,  9,  6,  3,  0, -1, -1, -1, -1, -1);
+    __m128i ssse3_green_indices_2 = _mm_set_epi8(14, 11,  8,  5,  2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
     __m128i ssse3_red_indices_0   = _mm_set_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 14, 11,  8,  5,  2);
     __m128i ssse3_red_indices_1   = _mm_set_epi8(-1, -1, -1, -1, -1, -1, 13, 10,  7,  4,  1, -1, -1, -1, -1, -1);
     __m128i ssse3_red_indices_2   = _mm_set_epi8(15, 12,  9,  6,  3,  0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
@@ -120,9 +133,26 @@ void ConvertColor_BGR2GRAY_BT709_simd(const cv::Mat& src, cv::Mat& dst)
                                                     _mm_shuffle_epi8(chunk1, ssse3_red_indices_1)),
                                                     _mm_shuffle_epi8(chunk2, ssse3_red_indices_2));
 
-            /* ??? */
+            __m128i green = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(chunk0, ssse3_green_indices_0),
+                                                      _mm_shuffle_epi8(chunk1, ssse3_green_indices_1)),
+                                                      _mm_shuffle_epi8(chunk2, ssse3_green_indices_2));
+
+            __m128i blue = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(chunk0, ssse3_blue_indices_0),
+                                                     _mm_shuffle_epi8(chunk1, ssse3_blue_indices_1)),
+                                                     _mm_shuffle_epi8(chunk2, ssse3_blue_indices_2));
 
-            __m128i gray_packed; // Initialize it properly
+            // Widen to 16 bits: the weighted sum is at most 255 * 256 + 128,
+            // so it fits into unsigned 16-bit lanes and a logical shift is enough
+            __m128i gray_lo = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(red, zero), red_coeff),
+                                                          _mm_mullo_epi16(_mm_unpacklo_epi8(green, zero), green_coeff)),
+                                            _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(blue, zero), blue_coeff),
+                                                          bias));
+            __m128i gray_hi = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(red, zero), red_coeff),
+                                                          _mm_mullo_epi16(_mm_unpackhi_epi8(green, zero), green_coeff)),
+                                            _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(blue, zero), blue_coeff),
+                                                          bias));
+
+            __m128i gray_packed = _mm_packus_epi16(_mm_srli_epi16(gray_lo, 8), _mm_srli_epi16(gray_hi, 8));
 
             _mm_storeu_si128((__m128i*)(pdst + x), gray_packed);
         }
@@ -135,8 +165,154 @@ void ConvertColor_BGR2GRAY_BT709_simd(const cv::Mat& src, cv::Mat& dst)
             pdst[x] = (int)(color + 0.5);
         }
     }
+}
+
+//
+// Runtime dispatch between SSSE3, AVX2 and AVX-512BW versions
+//
+
+typedef void (*ConvertColorRow)(const uchar* src, uchar* dst, int width);
+
+// The AVX files hold only row kernels, the Mat handling stays in this file
+static void convertRows(const cv::Mat& src, cv::Mat& dst, ConvertColorRow row)
+{
+    CV_Assert(CV_8UC3 == src.type());
+    cv::Size sz = src.size();
+    dst.create(sz, CV_8UC1);
+
+    for (int y = 0; y < sz.height; y++)
+    {
+        row(src.ptr<uchar>(y), dst.ptr<uchar>(y), sz.width);
+    }
+}
+
+void ConvertColor_BGR2GRAY_BT709_avx2(const cv::Mat& src, cv::Mat& dst)
+{
+#ifdef HAVE_AVX2
+    convertRows(src, dst, ConvertColor_BGR2GRAY_BT709_avx2_row);
+#else
+    ConvertColor_BGR2GRAY_BT709_simd(src, dst);
+#endif
+}
+
+void ConvertColor_BGR2GRAY_BT709_avx512(const cv::Mat& src, cv::Mat& dst)
+{
+#ifdef HAVE_AVX512BW
+    convertRows(src, dst, ConvertColor_BGR2GRAY_BT709_avx512_row);
+#else
+    ConvertColor_BGR2GRAY_BT709_simd(src, dst);
+#endif
+}
+
+static void cpuid(int leaf, int subleaf, unsigned regs[4])
+{
+    regs[0] = regs[1] = regs[2] = regs[3] = 0;
+#if defined _MSC_VER
+    int r[4];
+    __cpuidex(r, leaf, subleaf);
+    for (int i = 0; i < 4; i++) regs[i] = (unsigned)r[i];
+#elif defined __GNUC__ && (defined __i386__ || defined __x86_64__)
+    if ((unsigned)leaf <= __get_cpuid_max(leaf & 0x80000000, 0))
+        __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// State components enabled by the OS in XCR0 (needs OSXSAVE)
+static unsigned long long xgetbv0()
+{
+#if defined _MSC_VER
+    return _xgetbv(0);
+#elif defined __GNUC__ && (defined __i386__ || defined __x86_64__)
+    unsigned eax, edx;
+    __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((unsigned long long)edx << 32) | eax;
+#else
+    return 0;
+#endif
+}
+
+static SimdLevel detectSimdLevel()
+{
+    unsigned regs1[4], regs7[4];
+    cpuid(1, 0, regs1);
+    cpuid(7, 0, regs7);
+
+    SimdLevel level = SIMD_NONE;
+    if (!(regs1[2] & (1u << 9)))                      // SSSE3
+        return level;
+    level = SIMD_SSSE3;
+
+    if (!(regs1[2] & (1u << 27)))                     // OSXSAVE
+        return level;
+    const unsigned long long xcr0 = xgetbv0();
+
+    if ((xcr0 & 0x6) != 0x6 || !(regs7[1] & (1u << 5))) // YMM state, AVX2
+        return level;
+    level = SIMD_AVX2;
+
+    if ((xcr0 & 0xE0) != 0xE0 ||                      // opmask and ZMM state
+        !(regs7[1] & (1u << 16)) || !(regs7[1] & (1u << 30))) // AVX512F, AVX512BW
+        return level;
+    return SIMD_AVX512BW;
+}
+
+SimdLevel ConvertColor_GetSimdLevel()
+{
+    static const SimdLevel level = detectSimdLevel();
+
+    SimdLevel compiled = SIMD_NONE;
+#ifdef HAVE_SSE
+    compiled = SIMD_SSSE3;
+#endif
+#ifdef HAVE_AVX2
+    compiled = SIMD_AVX2;
+#endif
+#ifdef HAVE_AVX512BW
+    compiled = SIMD_AVX512BW;
+#endif
+
+    return level < compiled ? level : compiled;
+}
+
+std::string GetCpuModelName()
+{
+    // Brand string from the extended leaves 0x80000002..0x80000004
+    unsigned regs[4];
+    cpuid(0x80000000, 0, regs);
+    if (regs[0] < 0x80000004)
+        return "unknown";
+
+    char brand[49] = { 0 };
+    for (int i = 0; i < 3; i++)
+    {
+        cpuid(0x80000002 + i, 0, regs);
+        memcpy(brand + 16 * i, regs, 16);
+    }
 
-    // ! Remove this before writing your optimizations !
-    ConvertColor_BGR2GRAY_BT709_fpt(src, dst);
-    // ! Remove this before writing your optimizations !
+    std::string name(brand);
+    const size_t first = name.find_first_not_of(' ');
+    return first == std::string::npos ? "unknown" : name.substr(first);
+}
+
+void ConvertColor_BGR2GRAY_BT709_dispatch(const cv::Mat& src, cv::Mat& dst)
+{
+    switch (ConvertColor_GetSimdLevel())
+    {
+#ifdef HAVE_AVX512BW
+    case SIMD_AVX512BW:
+        convertRows(src, dst, ConvertColor_BGR2GRAY_BT709_avx512_row);
+        break;
+#endif
+#ifdef HAVE_AVX2
+    case SIMD_AVX2:
+        convertRows(src, dst, ConvertColor_BGR2GRAY_BT709_avx2_row);
+        break;
+#endif
+    case SIMD_SSSE3:
+        ConvertColor_BGR2GRAY_BT709_simd(src, dst);
+        break;
+    default:
+        ConvertColor_BGR2GRAY_BT709_fpt(src, dst);
+        break;
+    }
 }
@@ -0,0 +1,83 @@
+#include "convertcolor_isa.hpp"
+
+// This file is compiled with AVX2 code generation enabled (see src/CMakeLists.txt),
+// so it must be called only after ConvertColor_GetSimdLevel() confirmed the support.
+// It includes no OpenCV headers, see convertcolor_isa.hpp.
+#if defined __AVX2__
+#  include "immintrin.h"
+
+void ConvertColor_BGR2GRAY_BT709_avx2_row(const unsigned char* psrc, unsigned char* pdst, int width)
+{
+    // Same per-lane indices as in the SSSE3 version: every 128-bit lane holds 16 pixels
+    __m128i blue_indices_0  = _mm_set_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 15, 12,  9,  6,  3,  0);
+    __m128i blue_indices_1  = _mm_set_epi8(-1, -1, -1, -1, -1, 14, 11,  8,  5,  2, -1, -1, -1, -1, -1, -1);
+    __m128i blue_indices_2  = _mm_set_epi8(13, 10,  7,  4,  1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    __m128i green_indices_0 = _mm_set_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 13, 10,  7,  4,  1);
+    __m128i green_indices_1 = _mm_set_epi8(-1, -1, -1, -1, -1, 15, 12,  9,  6,  3,  0, -1, -1, -1, -1, -1);
+    __m128i green_indices_2 = _mm_set_epi8(14, 11,  8,  5,  2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    __m128i red_indices_0   = _mm_set_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 14, 11,  8,  5,  2);
+    __m128i red_indices_1   = _mm_set_epi8(-1, -1, -1, -1, -1, -1, 13, 10,  7,  4,  1, -1, -1, -1, -1, -1);
+    __m128i red_indices_2   = _mm_set_epi8(15, 12,  9,  6,  3,  0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+
+    __m256i b0 = _mm256_broadcastsi128_si256(blue_indices_0);
+    __m256i b1 = _mm256_broadcastsi128_si256(blue_indices_1);
+    __m256i b2 = _mm256_broadcastsi128_si256(blue_indices_2);
+    __m256i g0 = _mm256_broadcastsi128_si256(green_indices_0);
+    __m256i g1 = _mm256_broadcastsi128_si256(green_indices_1);
+    __m256i g2 = _mm256_broadcastsi128_si256(green_indices_2);
+    __m256i r0 = _mm256_broadcastsi128_si256(red_indices_0);
+    __m256i r1 = _mm256_broadcastsi128_si256(red_indices_1);
+    __m256i r2 = _mm256_broadcastsi128_si256(red_indices_2);
+
+    __m256i red_coeff   = _mm256_set1_epi16(54);
+    __m256i green_coeff = _mm256_set1_epi16(183);
+    __m256i blue_coeff  = _mm256_set1_epi16(19);
+    __m256i bias = _mm256_set1_epi16(128);
+    __m256i zero = _mm256_setzero_si256();
+
+    int x = 0;
+
+    // 32 pixels per iteration: pixels 0..15 go to the low lane, 16..31 to the high one
+    for (; x <= width - 32; x += 32)
+    {
+        const unsigned char* p = psrc + x*3;
+        __m256i chunk0 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(p + 16*0))),
+                                                 _mm_loadu_si128((const __m128i*)(p + 48 + 16*0)), 1);
+        __m256i chunk1 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(p + 16*1))),
+                                                 _mm_loadu_si128((const __m128i*)(p + 48 + 16*1)), 1);
+        __m256i chunk2 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(p + 16*2))),
+                                                 _mm_loadu_si128((const __m128i*)(p + 48 + 16*2)), 1);
+
+        __m256i red   = _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(chunk0, r0),
+                                                        _mm256_shuffle_epi8(chunk1, r1)),
+                                                        _mm256_shuffle_epi8(chunk2, r2));
+        __m256i green = _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(chunk0, g0),
+                                                        _mm256_shuffle_epi8(chunk1, g1)),
+                                                        _mm256_shuffle_epi8(chunk2, g2));
+        __m256i blue  = _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(chunk0, b0),
+                                                        _mm256_shuffle_epi8(chunk1, b1)),
+                                                        _mm256_shuffle_epi8(chunk2, b2));
+
+        // Unpack and pack work per lane, so the pixel order is preserved
+        __m256i gray_lo = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(red, zero), red_coeff),
+                                                            _mm256_mullo_epi16(_mm256_unpacklo_epi8(green, zero), green_coeff)),
+                                           _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(blue, zero), blue_coeff),
+                                                            bias));
+        __m256i gray_hi = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(red, zero), red_coeff),
+                                                            _mm256_mullo_epi16(_mm256_unpackhi_epi8(green, zero), green_coeff)),
+                                           _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(blue, zero), blue_coeff),
+                                                            bias));
+
+        __m256i gray_packed = _mm256_packus_epi16(_mm256_srli_epi16(gray_lo, 8), _mm256_srli_epi16(gray_hi, 8));
+
+        _mm256_storeu_si256((__m256i*)(pdst + x), gray_packed);
+    }
+
+    // Process leftover pixels
+    for (; x < width; x++)
+    {
+        float color = 0.2126 * psrc[3 * x + 2] + 0.7152 * psrc[3 * x + 1] + 0.0722 * psrc[3 * x];
+        pdst[x] = (int)(color + 0.5);
+    }
+}
+#endif
@@ -0,0 +1,90 @@
+#include "convertcolor_isa.hpp"
+
+// This file is compiled with AVX-512BW code generation enabled (see src/CMakeLists.txt),
+// so it must be called only after ConvertColor_GetSimdLevel() confirmed the support.
+// It includes no OpenCV headers, see convertcolor_isa.hpp.
+#if defined __AVX512BW__
+#  include "immintrin.h"
+
+// Gathers three-channel chunks of four consecutive 16-pixel groups into the lanes
+static inline __m512i LoadLanes(const unsigned char* p)
+{
+    __m512i v = _mm512_castsi128_si512(_mm_loadu_si128((const __m128i*)(p)));
+    v = _mm512_inserti32x4(v, _mm_loadu_si128((const __m128i*)(p + 48*1)), 1);
+    v = _mm512_inserti32x4(v, _mm_loadu_si128((const __m128i*)(p + 48*2)), 2);
+    v = _mm512_inserti32x4(v, _mm_loadu_si128((const __m128i*)(p + 48*3)), 3);
+    return v;
+}
+
+void ConvertColor_BGR2GRAY_BT709_avx512_row(const unsigned char* psrc, unsigned char* pdst, int width)
+{
+    // Same per-lane indices as in the SSSE3 version: every 128-bit lane holds 16 pixels
+    __m128i blue_indices_0  = _mm_set_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 15, 12,  9,  6,  3,  0);
+    __m128i blue_indices_1  = _mm_set_epi8(-1, -1, -1, -1, -1, 14, 11,  8,  5,  2, -1, -1, -1, -1, -1, -1);
+    __m128i blue_indices_2  = _mm_set_epi8(13, 10,  7,  4,  1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    __m128i green_indices_0 = _mm_set_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 13, 10,  7,  4,  1);
+    __m128i green_indices_1 = _mm_set_epi8(-1, -1, -1, -1, -1, 15, 12,  9,  6,  3,  0, -1, -1, -1, -1, -1);
+    __m128i green_indices_2 = _mm_set_epi8(14, 11,  8,  5,  2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    __m128i red_indices_0   = _mm_set_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 14, 11,  8,  5,  2);
+    __m128i red_indices_1   = _mm_set_epi8(-1, -1, -1, -1, -1, -1, 13, 10,  7,  4,  1, -1, -1, -1, -1, -1);
+    __m128i red_indices_2   = _mm_set_epi8(15, 12,  9,  6,  3,  0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+
+    __m512i b0 = _mm512_broadcast_i32x4(blue_indices_0);
+    __m512i b1 = _mm512_broadcast_i32x4(blue_indices_1);
+    __m512i b2 = _mm512_broadcast_i32x4(blue_indices_2);
+    __m512i g0 = _mm512_broadcast_i32x4(green_indices_0);
+    __m512i g1 = _mm512_broadcast_i32x4(green_indices_1);
+    __m512i g2 = _mm512_broadcast_i32x4(green_indices_2);
+    __m512i r0 = _mm512_broadcast_i32x4(red_indices_0);
+    __m512i r1 = _mm512_broadcast_i32x4(red_indices_1);
+    __m512i r2 = _mm512_broadcast_i32x4(red_indices_2);
+
+    __m512i red_coeff   = _mm512_set1_epi16(54);
+    __m512i green_coeff = _mm512_set1_epi16(183);
+    __m512i blue_coeff  = _mm512_set1_epi16(19);
+    __m512i bias = _mm512_set1_epi16(128);
+    __m512i zero = _mm512_setzero_si512();
+
+    int x = 0;
+
+    // 64 pixels per iteration: every 128-bit lane gets its own group of 16 pixels
+    for (; x <= width - 64; x += 64)
+    {
+        const unsigned char* p = psrc + x*3;
+        __m512i chunk0 = LoadLanes(p + 16*0);
+        __m512i chunk1 = LoadLanes(p + 16*1);
+        __m512i chunk2 = LoadLanes(p + 16*2);
+
+        __m512i red   = _mm512_or_si512(_mm512_or_si512(_mm512_shuffle_epi8(chunk0, r0),
+                                                        _mm512_shuffle_epi8(chunk1, r1)),
+                                                        _mm512_shuffle_epi8(chunk2, r2));
+        __m512i green = _mm512_or_si512(_mm512_or_si512(_mm512_shuffle_epi8(chunk0, g0),
+                                                        _mm512_shuffle_epi8(chunk1, g1)),
+                                                        _mm512_shuffle_epi8(chunk2, g2));
+        __m512i blue  = _mm512_or_si512(_mm512_or_si512(_mm512_shuffle_epi8(chunk0, b0),
+                                                        _mm512_shuffle_epi8(chunk1, b1)),
+                                                        _mm512_shuffle_epi8(chunk2, b2));
+
+        // Unpack and pack work per lane, so the pixel order is preserved
+        __m512i gray_lo = _mm512_add_epi16(_mm512_add_epi16(_mm512_mullo_epi16(_mm512_unpacklo_epi8(red, zero), red_coeff),
+                                                            _mm512_mullo_epi16(_mm512_unpacklo_epi8(green, zero), green_coeff)),
+                                           _mm512_add_epi16(_mm512_mullo_epi16(_mm512_unpacklo_epi8(blue, zero), blue_coeff),
+                                                            bias));
+        __m512i gray_hi = _mm512_add_epi16(_mm512_add_epi16(_mm512_mullo_epi16(_mm512_unpackhi_epi8(red, zero), red_coeff),
+                                                            _mm512_mullo_epi16(_mm512_unpackhi_epi8(green, zero), green_coeff)),
+                                           _mm512_add_epi16(_mm512_mullo_epi16(_mm512_unpackhi_epi8(blue, zero), blue_coeff),
+                                                            bias));
+
+        __m512i gray_packed = _mm512_packus_epi16(_mm512_srli_epi16(gray_lo, 8), _mm512_srli_epi16(gray_hi, 8));
+
+        _mm512_storeu_si512((__m512i*)(pdst + x), gray_packed);
+    }
+
+    // Process leftover pixels
+    for (; x < width; x++)
+    {
+        float color = 0.2126 * psrc[3 * x + 2] + 0.7152 * psrc[3 * x + 1] + 0.0722 * psrc[3 * x];
+        pdst[x] = (int)(color + 0.5);
+    }
+}
+#endif
@@ -0,0 +1,9 @@
+#pragma once
+
+// Row kernels of the files compiled with wider instruction sets. They work
+// on raw pointers and those files include no OpenCV or library headers:
+// an inline or template function from a shared header would get an AVX
+// copy there, and the linker may keep that copy for the whole program.
+// Checks, allocation and the loop over rows stay in convertcolor.cpp.
+void ConvertColor_BGR2GRAY_BT709_avx2_row(const unsigned char* src, unsigned char* dst, int width);
+void ConvertColor_BGR2GRAY_BT709_avx512_row(const unsigned char* src, unsigned char* dst, int width);
@@ -0,0 +1,85 @@
+#include "skeleton_filter.hpp"
+#include "row_kernels.hpp"
+
+#include <vector>
+#include <algorithm>
+
+// Same as cv::threshold(row, row, 128, 255, cv::THRESH_BINARY_INV)
+static void ThresholdRowInv(uchar* row, int width)
+{
+    for (int x = 0; x < width; x++)
+        row[x] = row[x] > 128 ? 0 : 255;
+}
+
+void ConvertResizeThreshold_fused(const cv::Mat& input, cv::Mat& binary, const cv::Size small_size,
+                                  std::vector<uchar>& gray, std::vector<ushort>& buffer)
+{
+    CV_Assert(CV_8UC3 == input.type());
+    const cv::Size src_size = input.size();
+    const int cols = input.cols;
+    binary.create(small_size, CV_8UC1);
+
+    // No reallocation if the buffers were already sized for this input width
+    gray.resize(3 * cols + 1);
+    buffer.resize(2 * cols + 1);
+
+    if (ImageResize_3to2_supported(src_size, small_size))
+    {
+        // Every 3 gray rows give 2 output rows, nothing else is kept
+        uchar* g[3] = { &gray[0], &gray[cols], &gray[2 * cols] };
+
+        for (int row = 0, y = 0; row < small_size.height; row += 2, y += 3)
+        {
+            for (int k = 0; k < 3; k++)
+                ConvertColor_BGR2GRAY_BT709_row(input.ptr<uchar>(y + k), g[k], cols);
+
+            uchar* d0 = binary.ptr<uchar>(row);
+            uchar* d1 = binary.ptr<uchar>(row + 1);
+            ImageResize_3to2_rows(g[0], g[1], g[2], cols, &buffer[0], d0, d1);
+            ThresholdRowInv(d0, small_size.width);
+            ThresholdRowInv(d1, small_size.width);
+        }
+        return;
+    }
+
+    // Generic ratio: only the two gray rows the current output row reads are
+    // kept, and they are converted only when the resizer moves on to them
+    uchar* g[2] = { &gray[0], &gray[cols] };
+    int gidx[2] = { -1, -1 };
+
+    for (int row = 0; row < small_size.height; row++)
+    {
+        int y1, y2;
+        ImageResize_rowSources(src_size, small_size, row, y1, y2);
+
+        if (gidx[0] != y1)
+        {
+            if (gidx[1] == y1)
+            {
+                std::swap(g[0], g[1]);
+                std::swap(gidx[0], gidx[1]);
+            }
+            else
+            {
+                ConvertColor_BGR2GRAY_BT709_row(input.ptr<uchar>(y1), g[0], cols);
+                gidx[0] = y1;
+            }
+        }
+        if (gidx[1] != y2)
+        {
+            ConvertColor_BGR2GRAY_BT709_row(input.ptr<uchar>(y2), g[1], cols);
+            gidx[1] = y2;
+        }
+
+        uchar* pdst = binary.ptr<uchar>(row);
+        ImageResize_row(g[0], g[1], src_size, small_size, row, pdst);
+        ThresholdRowInv(pdst, small_size.width);
+    }
+}
+
+void ConvertResizeThreshold_fused(const cv::Mat& input, cv::Mat& binary, const cv::Size small_size)
+{
+    std::vector<uchar> gray;
+    std::vector<ushort> buffer;
+    ConvertResizeThreshold_fused(input, binary, small_size, gray, buffer);
+}
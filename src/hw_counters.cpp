@@ -0,0 +1,131 @@
+#include "hw_counters.hpp"
+
+#if defined __linux__
+#  include <linux/perf_event.h>
+#  include <sys/syscall.h>
+#  include <pthread.h>
+#  include <unistd.h>
+#  include <string.h>
+#endif
+
+#if defined __linux__
+
+static const int EVENT_COUNT = 4;
+
+static const unsigned long long event_configs[EVENT_COUNT] =
+{
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES
+};
+
+// One counter group per thread, closed by the thread-specific key destructor
+struct CounterGroup
+{
+    int leader;
+    int fds[EVENT_COUNT];
+    int slots[EVENT_COUNT];     // position of the event in a group read, -1 if not opened
+    int opened;
+};
+
+static int openEvent(unsigned long long config, int group_fd)
+{
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    // This thread on any CPU
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+static void closeGroup(void* p)
+{
+    CounterGroup* group = (CounterGroup*)p;
+    for (int i = 0; i < EVENT_COUNT; i++)
+    {
+        if (group->fds[i] >= 0)
+            close(group->fds[i]);
+    }
+    delete group;
+}
+
+static pthread_key_t group_key;
+static pthread_once_t group_key_once = PTHREAD_ONCE_INIT;
+
+static void createGroupKey()
+{
+    pthread_key_create(&group_key, closeGroup);
+}
+
+static CounterGroup* threadGroup()
+{
+    pthread_once(&group_key_once, createGroupKey);
+
+    CounterGroup* group = (CounterGroup*)pthread_getspecific(group_key);
+    if (group)
+        return group;
+
+    group = new CounterGroup;
+    group->leader = -1;
+    group->opened = 0;
+    for (int i = 0; i < EVENT_COUNT; i++)
+    {
+        // The first event which opens leads the group, the others join it
+        group->fds[i] = openEvent(event_configs[i], group->leader);
+        group->slots[i] = -1;
+        if (group->fds[i] < 0)
+            continue;
+        if (group->leader < 0)
+            group->leader = group->fds[i];
+        group->slots[i] = group->opened++;
+    }
+    pthread_setspecific(group_key, group);
+    return group;
+}
+
+bool HardwareCounters_Read(HardwareEvents& events)
+{
+    int64* values[EVENT_COUNT] = { &events.cycles, &events.instructions, &events.cache_misses, &events.branch_misses };
+    for (int i = 0; i < EVENT_COUNT; i++)
+        *values[i] = -1;
+
+    CounterGroup* group = threadGroup();
+    if (group->leader < 0)
+        return false;
+
+    // nr, time_enabled, time_running, then the values in the order of opening
+    unsigned long long data[3 + EVENT_COUNT];
+    if (read(group->leader, data, sizeof(data)) < (ssize_t)((3 + group->opened) * sizeof(data[0])))
+        return false;
+
+    // Scaled up if the kernel had to multiplex the counters
+    const double scale = data[2] ? (double)data[1] / data[2] : 1.;
+    for (int i = 0; i < EVENT_COUNT; i++)
+    {
+        if (group->slots[i] >= 0)
+            *values[i] = (int64)(data[3 + group->slots[i]] * scale);
+    }
+    return true;
+}
+
+#else
+
+bool HardwareCounters_Read(HardwareEvents& events)
+{
+    events.cycles = events.instructions = events.cache_misses = events.branch_misses = -1;
+    return false;
+}
+
+#endif
+
+bool HardwareCounters_Available()
+{
+    HardwareEvents events;
+    return HardwareCounters_Read(events);
+}
@@ -0,0 +1,183 @@
+#include "image_writer.hpp"
+#include "threads.hpp"
+
+#include "opencv2/highgui/highgui.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <deque>
+#include <vector>
+
+// Enough for the images of a couple of skeletonize calls
+static const int WRITER_QUEUE_CAPACITY = 16;
+
+struct WriteJob
+{
+    std::string filename;
+    cv::Mat image;
+};
+
+static std::string dumpFilename(const std::string& filename, const cv::Mat& image, ImageDumpFormat format)
+{
+    if (format != IMAGE_DUMP_PNM)
+        return filename;
+    const size_t dot = filename.rfind('.');
+    const size_t slash = filename.find_last_of("/\\");
+    const std::string base = (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+                             ? filename : filename.substr(0, dot);
+    return base + (image.channels() == 1 ? ".pgm" : ".ppm");
+}
+
+class ImageWriterState
+{
+public:
+    ImageWriterState() : format(IMAGE_DUMP_PNG), copying(0), writing(0), failed(0), stop(false), started(false)
+    {
+        const char* env = getenv("SKELETON_DUMP_FORMAT");
+        if (env && std::string(env) == "pnm")
+            format = IMAGE_DUMP_PNM;
+        else if (env && *env && std::string(env) != "png")
+            fprintf(stderr, "Warning: unknown SKELETON_DUMP_FORMAT=%s, PNG is used\n", env);
+    }
+
+    ~ImageWriterState()
+    {
+        if (!started)
+            return;
+        monitor.lock();
+        stop = true;
+        monitor.notifyAll();
+        monitor.unlock();
+        joinThread(thread);
+        if (failed > 0)
+            fprintf(stderr, "Warning: failed to write %d intermediate images\n", failed);
+    }
+
+    // Called with the monitor locked
+    void ensureStarted()
+    {
+        if (started)
+            return;
+        start.func = run;
+        start.arg = this;
+        startThread(thread, &start);
+        started = true;
+    }
+
+    static void run(void* arg)
+    {
+        ImageWriterState* state = (ImageWriterState*)arg;
+        ThreadMonitor& monitor = state->monitor;
+
+        monitor.lock();
+        for (;;)
+        {
+            while (state->queue.empty() && !state->stop)
+                monitor.wait();
+            if (state->queue.empty())
+                break;
+
+            WriteJob job = state->queue.front();
+            state->queue.pop_front();
+            state->writing++;
+            monitor.unlock();
+
+            const bool ok = cv::imwrite(job.filename, job.image);
+
+            monitor.lock();
+            state->writing--;
+            if (!ok)
+                state->failed++;
+            // The buffer is reused by a later image of the same size and type,
+            // the oldest one goes when the images of other sizes fill the list
+            if ((int)state->spare.size() >= WRITER_QUEUE_CAPACITY)
+                state->spare.erase(state->spare.begin());
+            state->spare.push_back(job.image);
+            monitor.notifyAll();
+        }
+        monitor.unlock();
+    }
+
+    ThreadMonitor monitor;
+    ImageDumpFormat format;
+    std::deque<WriteJob> queue;
+    std::vector<cv::Mat> spare;
+    int copying;    // slots taken by callers still copying their images
+    int writing;
+    int failed;
+    bool stop;
+    bool started;
+
+    ThreadStart start;
+    ThreadHandle thread;
+};
+
+static ImageWriterState& writerState()
+{
+    static ImageWriterState state;
+    return state;
+}
+
+void ImageWriter_SetFormat(ImageDumpFormat format)
+{
+    ImageWriterState& state = writerState();
+    state.monitor.lock();
+    state.format = format;
+    state.monitor.unlock();
+}
+
+ImageDumpFormat ImageWriter_GetFormat()
+{
+    ImageWriterState& state = writerState();
+    state.monitor.lock();
+    const ImageDumpFormat format = state.format;
+    state.monitor.unlock();
+    return format;
+}
+
+void ImageWriter_Write(const std::string& filename, const cv::Mat& image)
+{
+    ImageWriterState& state = writerState();
+    WriteJob job;
+
+    // Waits for room before copying, so at most a queue of copies is alive
+    state.monitor.lock();
+    state.ensureStarted();
+    while ((int)state.queue.size() + state.copying + state.writing >= WRITER_QUEUE_CAPACITY)
+        state.monitor.wait();
+    state.copying++;
+    job.filename = dumpFilename(filename, image, state.format);
+    for (size_t i = state.spare.size(); i-- > 0; )
+    {
+        if (state.spare[i].size() == image.size() && state.spare[i].type() == image.type())
+        {
+            job.image = state.spare[i];
+            state.spare.erase(state.spare.begin() + i);
+            break;
+        }
+    }
+    state.monitor.unlock();
+
+    // The caller may change the image right after the call.
+    // A new buffer is allocated here when no spare one matches.
+    image.copyTo(job.image);
+
+    state.monitor.lock();
+    state.copying--;
+    state.queue.push_back(job);
+    state.monitor.notifyAll();
+    state.monitor.unlock();
+}
+
+int ImageWriter_Flush()
+{
+    ImageWriterState& state = writerState();
+    state.monitor.lock();
+    while (!state.queue.empty() || state.copying > 0 || state.writing > 0)
+        state.monitor.wait();
+    const int failed = state.failed;
+    state.failed = 0;
+    state.monitor.unlock();
+    return failed;
+}
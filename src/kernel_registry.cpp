@@ -0,0 +1,251 @@
+#include "kernel_registry.hpp"
+#include "skeleton_filter.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Adapters to the kernel signatures
+
+static void ImageResize_3to2_kernel(const cv::Mat& src, cv::Mat& dst, const cv::Size sz)
+{
+    // Falls back to the reference for other ratios
+    if (ImageResize_3to2_supported(src.size(), sz))
+        ImageResize_3to2(src, dst);
+    else
+        ImageResize(src, dst, sz);
+}
+
+static void GuoHallThinning_parallel_kernel(const cv::Mat& src, cv::Mat& dst)
+{
+    GuoHallThinning_parallel(src, dst);
+}
+
+static KernelInfo makeKernel(KernelStage stage, const char* name, int flags, ConvertColorKernel convert,
+                             ImageResizeKernel resize, ThinningKernel thinning)
+{
+    KernelInfo kernel;
+    kernel.stage = stage;
+    kernel.name = name;
+    kernel.flags = flags;
+    kernel.convert = convert;
+    kernel.resize = resize;
+    kernel.thinning = thinning;
+    return kernel;
+}
+
+static KernelInfo convertKernel(const char* name, int flags, ConvertColorKernel func)
+{
+    return makeKernel(KERNEL_CONVERTCOLOR, name, flags, func, 0, 0);
+}
+
+static KernelInfo resizeKernel(const char* name, int flags, ImageResizeKernel func)
+{
+    return makeKernel(KERNEL_RESIZE, name, flags, 0, func, 0);
+}
+
+static KernelInfo thinningKernel(const char* name, int flags, ThinningKernel func)
+{
+    return makeKernel(KERNEL_THINNING, name, flags, 0, 0, func);
+}
+
+static const char* stage_names[KERNEL_STAGE_COUNT] = { "convertcolor", "resize", "thinning" };
+
+static bool stageOf(const std::string& name, KernelStage& stage)
+{
+    for (int s = 0; s < KERNEL_STAGE_COUNT; s++)
+    {
+        if (name == stage_names[s])
+        {
+            stage = (KernelStage)s;
+            return true;
+        }
+    }
+    return false;
+}
+
+class KernelRegistry
+{
+public:
+    KernelRegistry()
+    {
+        add(convertKernel("baseline", KERNEL_EXACT,    ConvertColor_BGR2GRAY_BT709));
+        add(convertKernel("fpt",      0,               ConvertColor_BGR2GRAY_BT709_fpt));
+        add(convertKernel("simd",     KERNEL_SSSE3,    ConvertColor_BGR2GRAY_BT709_simd));
+        add(convertKernel("avx2",     KERNEL_AVX2,     ConvertColor_BGR2GRAY_BT709_avx2));
+        add(convertKernel("avx512",   KERNEL_AVX512BW, ConvertColor_BGR2GRAY_BT709_avx512));
+        add(convertKernel("dispatch", 0,               ConvertColor_BGR2GRAY_BT709_dispatch));
+
+        add(resizeKernel("baseline",  KERNEL_EXACT, ImageResize));
+        add(resizeKernel("3to2",      KERNEL_EXACT, ImageResize_3to2_kernel));
+        add(resizeKernel("optimized", 0,            ImageResize_optimized));
+
+        add(thinningKernel("baseline",  KERNEL_EXACT, GuoHallThinning));
+        add(thinningKernel("optimized", KERNEL_EXACT, GuoHallThinning_optimized));
+        add(thinningKernel("bitpacked", KERNEL_EXACT, GuoHallThinning_bitpacked));
+        add(thinningKernel("frontier",  KERNEL_EXACT, GuoHallThinning_frontier));
+        add(thinningKernel("table",     KERNEL_EXACT, GuoHallThinning_table));
+        add(thinningKernel("parallel",  KERNEL_EXACT | KERNEL_PARALLEL, GuoHallThinning_parallel_kernel));
+
+        // What skeletonize has always run
+        selected[KERNEL_CONVERTCOLOR] = find(KERNEL_CONVERTCOLOR, "baseline");
+        selected[KERNEL_RESIZE]       = find(KERNEL_RESIZE, "3to2");
+        selected[KERNEL_THINNING]     = find(KERNEL_THINNING, "baseline");
+
+        const char* env = getenv("SKELETON_KERNELS");
+        if (env && !configure(env))
+            fprintf(stderr, "Warning: SKELETON_KERNELS=%s has unknown or unsupported kernels, "
+                            "they are ignored\n", env);
+    }
+
+    void add(const KernelInfo& kernel)
+    {
+        const int index = find(kernel.stage, kernel.name);
+        if (index >= 0)
+            kernels[kernel.stage][index] = kernel;
+        else
+            kernels[kernel.stage].push_back(kernel);
+    }
+
+    int find(KernelStage stage, const std::string& name) const
+    {
+        for (size_t i = 0; i < kernels[stage].size(); i++)
+        {
+            if (kernels[stage][i].name == name)
+                return (int)i;
+        }
+        return -1;
+    }
+
+    bool select(KernelStage stage, const std::string& name)
+    {
+        const int index = find(stage, name);
+        if (index < 0 || !Kernels_Supported(kernels[stage][index]))
+            return false;
+        selected[stage] = index;
+        return true;
+    }
+
+    // Comma-separated list of stage=kernel pairs
+    bool configure(const std::string& config)
+    {
+        bool ok = true;
+        size_t begin = 0;
+        while (begin < config.size())
+        {
+            size_t end = config.find(',', begin);
+            if (end == std::string::npos)
+                end = config.size();
+            const std::string item = config.substr(begin, end - begin);
+            begin = end + 1;
+
+            if (item.empty())
+                continue;
+            const size_t eq = item.find('=');
+            KernelStage stage;
+            if (eq == std::string::npos || !stageOf(item.substr(0, eq), stage) || !select(stage, item.substr(eq + 1)))
+                ok = false;
+        }
+        return ok;
+    }
+
+    cv::Mutex mutex;
+    std::vector<KernelInfo> kernels[KERNEL_STAGE_COUNT];
+    int selected[KERNEL_STAGE_COUNT];
+};
+
+static KernelRegistry& registry()
+{
+    static KernelRegistry instance;
+    return instance;
+}
+
+const char* Kernels_StageName(KernelStage stage)
+{
+    CV_Assert(0 <= stage && stage < KERNEL_STAGE_COUNT);
+    return stage_names[stage];
+}
+
+void Kernels_Register(const KernelInfo& kernel)
+{
+    CV_Assert(0 <= kernel.stage && kernel.stage < KERNEL_STAGE_COUNT);
+    KernelRegistry& r = registry();
+    cv::AutoLock lock(r.mutex);
+    r.add(kernel);
+}
+
+std::vector<KernelInfo> Kernels_List(KernelStage stage)
+{
+    CV_Assert(0 <= stage && stage < KERNEL_STAGE_COUNT);
+    KernelRegistry& r = registry();
+    cv::AutoLock lock(r.mutex);
+    return r.kernels[stage];
+}
+
+bool Kernels_Supported(const KernelInfo& kernel)
+{
+    const SimdLevel level = ConvertColor_GetSimdLevel();
+    if ((kernel.flags & KERNEL_AVX512BW) && level < SIMD_AVX512BW)
+        return false;
+    if ((kernel.flags & KERNEL_AVX2) && level < SIMD_AVX2)
+        return false;
+    if ((kernel.flags & KERNEL_SSSE3) && level < SIMD_SSSE3)
+        return false;
+    return true;
+}
+
+bool Kernels_Select(KernelStage stage, const std::string& name)
+{
+    CV_Assert(0 <= stage && stage < KERNEL_STAGE_COUNT);
+    KernelRegistry& r = registry();
+    cv::AutoLock lock(r.mutex);
+    return r.select(stage, name);
+}
+
+bool Kernels_Configure(const std::string& config)
+{
+    KernelRegistry& r = registry();
+    cv::AutoLock lock(r.mutex);
+    return r.configure(config);
+}
+
+KernelInfo Kernels_Selected(KernelStage stage)
+{
+    CV_Assert(0 <= stage && stage < KERNEL_STAGE_COUNT);
+    KernelRegistry& r = registry();
+    cv::AutoLock lock(r.mutex);
+    return r.kernels[stage][r.selected[stage]];
+}
+
+// Without copying the whole KernelInfo, these are called on every image
+
+ConvertColorKernel Kernels_ConvertColor()
+{
+    KernelRegistry& r = registry();
+    cv::AutoLock lock(r.mutex);
+    return r.kernels[KERNEL_CONVERTCOLOR][r.selected[KERNEL_CONVERTCOLOR]].convert;
+}
+
+ImageResizeKernel Kernels_ImageResize()
+{
+    KernelRegistry& r = registry();
+    cv::AutoLock lock(r.mutex);
+    return r.kernels[KERNEL_RESIZE][r.selected[KERNEL_RESIZE]].resize;
+}
+
+ThinningKernel Kernels_Thinning()
+{
+    KernelRegistry& r = registry();
+    cv::AutoLock lock(r.mutex);
+    return r.kernels[KERNEL_THINNING][r.selected[KERNEL_THINNING]].thinning;
+}
+
+KernelSet Kernels_SelectedSet()
+{
+    KernelRegistry& r = registry();
+    cv::AutoLock lock(r.mutex);
+    KernelSet kernels;
+    kernels.convert = r.kernels[KERNEL_CONVERTCOLOR][r.selected[KERNEL_CONVERTCOLOR]].convert;
+    kernels.resize = r.kernels[KERNEL_RESIZE][r.selected[KERNEL_RESIZE]].resize;
+    kernels.thinning = r.kernels[KERNEL_THINNING][r.selected[KERNEL_THINNING]].thinning;
+    return kernels;
+}
@@ -0,0 +1,219 @@
+#include "mat_pool.hpp"
+#include "memory_stats.hpp"
+
+#include <stdlib.h>
+#include <string>
+#include <map>
+#include <vector>
+
+static const size_t POOL_ALIGNMENT = 64;
+static const size_t POOL_DEFAULT_LIMIT = (size_t)256 << 20;
+static const size_t POOL_CLASS_BLOCKS = 16;   // free blocks kept per size class
+
+// Smallest class of the form m * 2^k, m = 4..7, which fits 'size',
+// so a block wastes at most a fifth of itself
+static size_t sizeClass(size_t size)
+{
+    if (size <= POOL_ALIGNMENT)
+        return POOL_ALIGNMENT;
+    int k = 0;
+    while ((size >> k) >= 8)
+        k++;
+    size_t m = (size + ((size_t)1 << k) - 1) >> k;
+    if (m > 7)
+    {
+        m = 4;
+        k++;
+    }
+    return m << k;
+}
+
+// The pointer returned by malloc is kept right before the aligned block
+static uchar* alignedAlloc(size_t size)
+{
+    uchar* base = (uchar*)malloc(size + POOL_ALIGNMENT + sizeof(void*));
+    if (!base)
+        CV_Error(CV_StsNoMem, "Failed to allocate an image buffer");
+    uchar* block = cv::alignPtr(base + sizeof(void*), (int)POOL_ALIGNMENT);
+    ((void**)block)[-1] = base;
+    return block;
+}
+
+static void alignedFree(uchar* block)
+{
+    free(((void**)block)[-1]);
+}
+
+// The same layout as of the counting allocator: the reference counter
+// follows the data, the capacity of the block follows the counter
+class PooledMatAllocator : public cv::MatAllocator
+{
+public:
+    PooledMatAllocator() : enabled(1), limit(POOL_DEFAULT_LIMIT), cached(0), hits(0), misses(0)
+    {
+        const char* env = getenv("SKELETON_MAT_POOL");
+        if (env && std::string(env) == "0")
+            enabled = 0;
+    }
+
+    void allocate(int dims, const int* sizes, int type, int*& refcount,
+                  uchar*& datastart, uchar*& data, size_t* step)
+    {
+        size_t total = CV_ELEM_SIZE(type);
+        for (int i = dims - 1; i >= 0; i--)
+        {
+            step[i] = total;
+            total *= sizes[i];
+        }
+        total = cv::alignSize(total, (int)sizeof(size_t));
+
+        const size_t capacity = sizeClass(total + 2 * sizeof(size_t));
+        data = datastart = take(capacity);
+        refcount = (int*)(data + total);
+        *refcount = 1;
+        *(size_t*)(data + total + sizeof(size_t)) = capacity;
+    }
+
+    void deallocate(int* refcount, uchar* datastart, uchar* /*data*/)
+    {
+        if (!refcount)
+            return;
+        const size_t capacity = *(size_t*)((uchar*)refcount + sizeof(size_t));
+        Memory_RecordFree(capacity);
+        give(datastart, capacity);
+    }
+
+    void trim()
+    {
+        std::map<size_t, std::vector<uchar*> > blocks;
+        {
+            cv::AutoLock lock(mutex);
+            blocks.swap(free_blocks);
+            cached = 0;
+        }
+        for (std::map<size_t, std::vector<uchar*> >::iterator it = blocks.begin(); it != blocks.end(); ++it)
+        {
+            for (size_t i = 0; i < it->second.size(); i++)
+                alignedFree(it->second[i]);
+        }
+    }
+
+    volatile int enabled;
+    size_t limit;
+
+    cv::Mutex mutex;
+    std::map<size_t, std::vector<uchar*> > free_blocks;  // by capacity
+    size_t cached;
+    int64 hits;
+    int64 misses;
+
+private:
+    // Hits only look up and shrink an existing free list, so they do not
+    // allocate anything themselves
+    uchar* take(size_t capacity)
+    {
+        bool known_class;
+        {
+            cv::AutoLock lock(mutex);
+            std::map<size_t, std::vector<uchar*> >::iterator it = free_blocks.find(capacity);
+            if (it != free_blocks.end() && !it->second.empty())
+            {
+                uchar* block = it->second.back();
+                it->second.pop_back();
+                cached -= capacity;
+                hits++;
+                Memory_RecordReuse(capacity);
+                return block;
+            }
+            misses++;
+            known_class = it != free_blocks.end();
+        }
+        if (!known_class)
+            addClass(capacity);
+
+        // Only the blocks from the heap are counted as allocations
+        Memory_RecordAlloc(capacity);
+        return alignedAlloc(capacity);
+    }
+
+    // The free list of a new size class is created once with its final
+    // capacity, on the miss which goes to the heap anyway
+    void addClass(size_t capacity)
+    {
+        std::vector<uchar*> blocks;
+        blocks.reserve(POOL_CLASS_BLOCKS);
+
+        cv::AutoLock lock(mutex);
+        std::vector<uchar*>& list = free_blocks[capacity];
+        if (list.capacity() < POOL_CLASS_BLOCKS)
+            list.swap(blocks);
+    }
+
+    void give(uchar* block, size_t capacity)
+    {
+        {
+            cv::AutoLock lock(mutex);
+            std::map<size_t, std::vector<uchar*> >::iterator it = free_blocks.find(capacity);
+            if (it != free_blocks.end() && it->second.size() < it->second.capacity() &&
+                cached + capacity <= limit)
+            {
+                it->second.push_back(block);
+                cached += capacity;
+                return;
+            }
+        }
+        alignedFree(block);
+    }
+};
+
+// Never destroyed, so that Mats released during the exit still find it
+static PooledMatAllocator& pool()
+{
+    static PooledMatAllocator* allocator = new PooledMatAllocator;
+    return *allocator;
+}
+
+cv::MatAllocator* MatPool_Allocator()
+{
+    PooledMatAllocator& allocator = pool();
+    if (!allocator.enabled)
+        return Memory_MatAllocator();
+    return &allocator;
+}
+
+void MatPool_SetEnabled(bool enabled)
+{
+    pool().enabled = enabled ? 1 : 0;
+}
+
+bool MatPool_IsEnabled()
+{
+    return pool().enabled != 0;
+}
+
+void MatPool_SetLimit(size_t bytes)
+{
+    {
+        cv::AutoLock lock(pool().mutex);
+        pool().limit = bytes;
+        if (pool().cached <= bytes)
+            return;
+    }
+    MatPool_Trim();
+}
+
+void MatPool_Trim()
+{
+    pool().trim();
+}
+
+MatPoolStats MatPool_GetStats()
+{
+    PooledMatAllocator& allocator = pool();
+    cv::AutoLock lock(allocator.mutex);
+    MatPoolStats stats;
+    stats.hits = allocator.hits;
+    stats.misses = allocator.misses;
+    stats.cached_bytes = (int64)allocator.cached;
+    return stats;
+}
@@ -0,0 +1,99 @@
+#include "memory_stats.hpp"
+
+#if defined _MSC_VER
+#  define THREAD_LOCAL __declspec(thread)
+#else
+#  define THREAD_LOCAL __thread
+#endif
+
+// Plain integers, so they need no construction in any thread
+static THREAD_LOCAL int64 thread_allocations;
+static THREAD_LOCAL int64 thread_bytes;
+static THREAD_LOCAL int64 thread_reuses;
+static THREAD_LOCAL int64 thread_live_bytes;
+static THREAD_LOCAL int64 thread_peak_bytes;
+
+void Memory_RecordAlloc(size_t bytes)
+{
+    thread_allocations++;
+    thread_bytes += bytes;
+    thread_live_bytes += bytes;
+    if (thread_live_bytes > thread_peak_bytes)
+        thread_peak_bytes = thread_live_bytes;
+}
+
+void Memory_RecordFree(size_t bytes)
+{
+    thread_live_bytes -= bytes;
+}
+
+void Memory_RecordReuse(size_t bytes)
+{
+    thread_reuses++;
+    thread_live_bytes += bytes;
+    if (thread_live_bytes > thread_peak_bytes)
+        thread_peak_bytes = thread_live_bytes;
+}
+
+MemoryCounters Memory_ReadCounters()
+{
+    MemoryCounters counters;
+    counters.allocations = thread_allocations;
+    counters.bytes = thread_bytes;
+    counters.reuses = thread_reuses;
+    counters.live_bytes = thread_live_bytes;
+    counters.peak_bytes = thread_peak_bytes;
+    return counters;
+}
+
+int64 Memory_BeginPeak()
+{
+    const int64 outer_peak = thread_peak_bytes;
+    thread_peak_bytes = thread_live_bytes;
+    return outer_peak;
+}
+
+void Memory_EndPeak(int64 outer_peak)
+{
+    if (outer_peak > thread_peak_bytes)
+        thread_peak_bytes = outer_peak;
+}
+
+// The same layout as the default allocation of cv::Mat, the reference
+// counter follows the data, and the size follows the counter
+class CountingMatAllocator : public cv::MatAllocator
+{
+public:
+    void allocate(int dims, const int* sizes, int type, int*& refcount,
+                  uchar*& datastart, uchar*& data, size_t* step)
+    {
+        size_t total = CV_ELEM_SIZE(type);
+        for (int i = dims - 1; i >= 0; i--)
+        {
+            step[i] = total;
+            total *= sizes[i];
+        }
+        total = cv::alignSize(total, (int)sizeof(size_t));
+
+        const size_t allocated = total + 2 * sizeof(size_t);
+        data = datastart = (uchar*)cv::fastMalloc(allocated);
+        refcount = (int*)(data + total);
+        *refcount = 1;
+        *(size_t*)(data + total + sizeof(size_t)) = allocated;
+        Memory_RecordAlloc(allocated);
+    }
+
+    void deallocate(int* refcount, uchar* datastart, uchar* /*data*/)
+    {
+        if (!refcount)
+            return;
+        Memory_RecordFree(*(size_t*)((uchar*)refcount + sizeof(size_t)));
+        cv::fastFree(datastart);
+    }
+};
+
+cv::MatAllocator* Memory_MatAllocator()
+{
+    static CountingMatAllocator allocator;
+    return &allocator;
+}
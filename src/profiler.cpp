@@ -0,0 +1,435 @@
+#include "profiler.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+
+#if defined _MSC_VER
+#  define THREAD_LOCAL __declspec(thread)
+#else
+#  define THREAD_LOCAL __thread
+#endif
+
+// Logarithmic bins of durations in microseconds, 8 per power of two
+static const int BINS_PER_OCTAVE = 8;
+static const int BIN_COUNT = 40 * BINS_PER_OCTAVE;
+
+// Distinct stage names recorded between two resets, the rest is dropped
+static const int MAX_STAGES = 64;
+
+struct StageHistogram
+{
+    StageHistogram() : calls(0), total(0), min(0), max(0), pixels(0), calling_thread_only(false),
+                       allocations(0), alloc_bytes(0), peak_bytes(0)
+    {
+        for (int bin = 0; bin < BIN_COUNT; bin++)
+            bins[bin] = 0;
+        events.cycles = events.instructions = events.cache_misses = events.branch_misses = -1;
+    }
+
+    int calls;
+    double total;           // all durations are in milliseconds
+    double min;
+    double max;
+    int bins[BIN_COUNT];
+
+    int64 pixels;
+    HardwareEvents events;  // -1 until the event is counted once
+    bool calling_thread_only;
+
+    int64 allocations;
+    int64 alloc_bytes;
+    int64 peak_bytes;
+};
+
+static void addEvent(int64& sum, int64 value)
+{
+    if (value < 0)
+        return;
+    sum = (sum < 0 ? 0 : sum) + value;
+}
+
+static void addEvents(HardwareEvents& sum, const HardwareEvents& events)
+{
+    addEvent(sum.cycles, events.cycles);
+    addEvent(sum.instructions, events.instructions);
+    addEvent(sum.cache_misses, events.cache_misses);
+    addEvent(sum.branch_misses, events.branch_misses);
+}
+
+// Times the calling thread handed work to other threads
+static THREAD_LOCAL int thread_handoffs;
+
+static int binOf(double ms)
+{
+    const double us = ms * 1000.;
+    if (us <= 1.)
+        return 0;
+    const int bin = (int)(log(us) / log(2.) * BINS_PER_OCTAVE) + 1;
+    return bin < BIN_COUNT ? bin : BIN_COUNT - 1;
+}
+
+// Geometric middle of a bin
+static double binValue(int bin)
+{
+    if (bin == 0)
+        return 0.001;
+    return pow(2., (bin - .5) / BINS_PER_OCTAVE) / 1000.;
+}
+
+static double percentile(const StageHistogram& h, double p)
+{
+    const int rank = std::max(1, (int)ceil(p * h.calls));
+    int count = 0;
+    for (int bin = 0; bin < BIN_COUNT; bin++)
+    {
+        count += h.bins[bin];
+        if (count >= rank)
+            return std::min(std::max(binValue(bin), h.min), h.max);
+    }
+    return h.max;
+}
+
+static bool endsWith(const std::string& s, const std::string& suffix)
+{
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+class ProfilerState
+{
+public:
+    ProfilerState() : enabled(0), counters(0), stage_count(0), dropped(0)
+    {
+        const char* env = getenv("SKELETON_PROFILE");
+        if (env && *env && std::string(env) != "0")
+        {
+            enabled = 1;
+            if (std::string(env) != "1")
+                output = env;
+        }
+
+        const char* env_counters = getenv("SKELETON_PROFILE_COUNTERS");
+        if (env_counters && std::string(env_counters) == "1")
+            counters = HardwareCounters_Available() ? 1 : 0;
+    }
+
+    // Called with the mutex locked. Slots are found by the address of the
+    // name literal and taken from the fixed array, so recording does not
+    // allocate; equal names from different places are merged on reading.
+    StageHistogram* find(const char* stage)
+    {
+        for (int i = 0; i < stage_count; i++)
+        {
+            if (names[i] == stage)
+                return &stages[i];
+        }
+        if (stage_count == MAX_STAGES)
+            return 0;
+        names[stage_count] = stage;
+        stages[stage_count] = StageHistogram();
+        return &stages[stage_count++];
+    }
+
+    volatile int enabled;
+    volatile int counters;
+    std::string output;
+
+    cv::Mutex mutex;
+    const char* names[MAX_STAGES];
+    StageHistogram stages[MAX_STAGES];
+    int stage_count;
+    int dropped;    // calls of the stages which found no free slot
+};
+
+static void writeAtExit();
+
+// Never destroyed. The summary is written by an atexit handler registered
+// on the first use, not by a static destructor, so it runs while the
+// statics created before (the image writer, OpenCV's) are still alive.
+static ProfilerState* createState()
+{
+    ProfilerState* state = new ProfilerState;
+    atexit(writeAtExit);
+    return state;
+}
+
+static ProfilerState& profilerState()
+{
+    static ProfilerState* state = createState();
+    return *state;
+}
+
+static void writeAtExit()
+{
+    ProfilerState& state = profilerState();
+    if (!state.enabled)
+        return;
+    {
+        cv::AutoLock lock(state.mutex);
+        if (state.stage_count == 0)
+            return;
+    }
+
+    if (endsWith(state.output, ".json") && Profiler_WriteJSON(state.output))
+        return;
+    if (endsWith(state.output, ".csv") && Profiler_WriteCSV(state.output))
+        return;
+    Profiler_Print();
+}
+
+void Profiler_SetEnabled(bool enabled)
+{
+    profilerState().enabled = enabled ? 1 : 0;
+}
+
+bool Profiler_IsEnabled()
+{
+    return profilerState().enabled != 0;
+}
+
+bool Profiler_SetHardwareCounters(bool enabled)
+{
+    ProfilerState& state = profilerState();
+    state.counters = enabled && HardwareCounters_Available() ? 1 : 0;
+    return state.counters == (enabled ? 1 : 0);
+}
+
+bool Profiler_HardwareCountersEnabled()
+{
+    return profilerState().counters != 0;
+}
+
+void Profiler_Record(const char* stage, int64 ticks, int64 pixels, const HardwareEvents* events,
+                     const MemoryCounters* memory, bool calling_thread_only)
+{
+    const double ms = 1000. * ticks / cv::getTickFrequency();
+
+    ProfilerState& state = profilerState();
+    cv::AutoLock lock(state.mutex);
+    StageHistogram* slot = state.find(stage);
+    if (!slot)
+    {
+        state.dropped++;
+        return;
+    }
+    StageHistogram& h = *slot;
+    h.min = h.calls ? std::min(h.min, ms) : ms;
+    h.max = h.calls ? std::max(h.max, ms) : ms;
+    h.total += ms;
+    h.calls++;
+    h.bins[binOf(ms)]++;
+    h.pixels += pixels;
+    if (events)
+        addEvents(h.events, *events);
+    h.calling_thread_only = h.calling_thread_only || calling_thread_only;
+    if (memory)
+    {
+        h.allocations += memory->allocations;
+        h.alloc_bytes += memory->bytes;
+        h.peak_bytes = std::max(h.peak_bytes, memory->peak_bytes);
+    }
+}
+
+void Profiler_NoteOtherThreads()
+{
+    thread_handoffs++;
+}
+
+void ProfileScope::begin()
+{
+    start_handoffs_ = thread_handoffs;
+    start_memory_ = Memory_ReadCounters();
+    outer_peak_ = Memory_BeginPeak();
+
+    // Counters are read inside the timed interval as little as possible
+    counting_ = Profiler_HardwareCountersEnabled() && HardwareCounters_Read(start_events_);
+    start_ = cv::getTickCount();
+}
+
+void ProfileScope::end()
+{
+    const int64 ticks = cv::getTickCount() - start_;
+
+    MemoryCounters memory = Memory_ReadCounters();
+    memory.allocations -= start_memory_.allocations;
+    memory.bytes -= start_memory_.bytes;
+    memory.peak_bytes -= start_memory_.live_bytes;
+    memory.live_bytes -= start_memory_.live_bytes;
+    Memory_EndPeak(outer_peak_);
+    const bool calling_thread_only = thread_handoffs != start_handoffs_;
+
+    if (!counting_)
+    {
+        Profiler_Record(stage_, ticks, pixels_, 0, &memory, calling_thread_only);
+        return;
+    }
+
+    HardwareEvents events;
+    HardwareCounters_Read(events);
+
+    // An event missing from either read stays -1
+    int64* ends[] = { &events.cycles, &events.instructions, &events.cache_misses, &events.branch_misses };
+    const int64 starts[] = { start_events_.cycles, start_events_.instructions,
+                             start_events_.cache_misses, start_events_.branch_misses };
+    for (int i = 0; i < 4; i++)
+        *ends[i] = (*ends[i] >= 0 && starts[i] >= 0) ? *ends[i] - starts[i] : -1;
+
+    Profiler_Record(stage_, ticks, pixels_, &events, &memory, calling_thread_only);
+}
+
+void Profiler_Reset()
+{
+    ProfilerState& state = profilerState();
+    cv::AutoLock lock(state.mutex);
+    state.stage_count = 0;
+    state.dropped = 0;
+}
+
+std::vector<ProfilerStageStats> Profiler_GetStats()
+{
+    ProfilerState& state = profilerState();
+    std::map<std::string, StageHistogram> merged;
+    {
+        cv::AutoLock lock(state.mutex);
+        if (state.dropped > 0)
+            fprintf(stderr, "Warning: the profiler has room for %d stages, %d calls of other stages were dropped\n",
+                    MAX_STAGES, state.dropped);
+        for (int i = 0; i < state.stage_count; i++)
+        {
+            const StageHistogram& src = state.stages[i];
+            StageHistogram& dst = merged[state.names[i]];
+
+            dst.min = dst.calls ? std::min(dst.min, src.min) : src.min;
+            dst.max = dst.calls ? std::max(dst.max, src.max) : src.max;
+            dst.total += src.total;
+            dst.calls += src.calls;
+            dst.pixels += src.pixels;
+            addEvents(dst.events, src.events);
+            dst.calling_thread_only = dst.calling_thread_only || src.calling_thread_only;
+            dst.allocations += src.allocations;
+            dst.alloc_bytes += src.alloc_bytes;
+            dst.peak_bytes = std::max(dst.peak_bytes, src.peak_bytes);
+            for (int bin = 0; bin < BIN_COUNT; bin++)
+                dst.bins[bin] += src.bins[bin];
+        }
+    }
+
+    std::vector<ProfilerStageStats> result;
+    for (std::map<std::string, StageHistogram>::const_iterator it = merged.begin(); it != merged.end(); ++it)
+    {
+        const StageHistogram& h = it->second;
+
+        ProfilerStageStats s;
+        s.name = it->first;
+        s.calls = h.calls;
+        s.total_ms = h.total;
+        s.min_ms = h.min;
+        s.median_ms = percentile(h, .5);
+        s.p99_ms = percentile(h, .99);
+        s.max_ms = h.max;
+        s.pixels = h.pixels;
+        s.events = h.events;
+        s.events_calling_thread_only = h.calling_thread_only;
+        s.allocations = h.allocations;
+        s.alloc_bytes = h.alloc_bytes;
+        s.peak_bytes = h.peak_bytes;
+        result.push_back(s);
+    }
+    return result;
+}
+
+// Event rates, negative when the events were not counted
+static double ratio(int64 a, int64 b)
+{
+    return (a >= 0 && b > 0) ? (double)a / b : -1.;
+}
+
+void Profiler_Print()
+{
+    const std::vector<ProfilerStageStats> stats = Profiler_GetStats();
+
+    bool events = false;
+    bool calling_thread_only = false;
+    for (size_t i = 0; i < stats.size(); i++)
+    {
+        events = events || stats[i].events.cycles >= 0;
+        calling_thread_only = calling_thread_only || stats[i].events_calling_thread_only;
+    }
+
+    printf("%-24s %8s %12s %10s %10s %10s %10s %10s %10s %10s",
+           "stage", "calls", "total, ms", "min", "median", "p99", "max", "allocs", "KB/call", "peak KB");
+    if (events)
+        printf(" %8s %14s %14s", "IPC", "cache-miss/px", "branch-miss/px");
+    printf("\n");
+
+    for (size_t i = 0; i < stats.size(); i++)
+    {
+        const ProfilerStageStats& s = stats[i];
+        printf("%-24s %8d %12.2f %10.2f %10.2f %10.2f %10.2f %10.1f %10.1f %10.1f",
+               s.name.c_str(), s.calls, s.total_ms, s.min_ms, s.median_ms, s.p99_ms, s.max_ms,
+               (double)s.allocations / s.calls, s.alloc_bytes / 1024. / s.calls, s.peak_bytes / 1024.);
+        if (events)
+            printf(" %8.2f %14.4f %14.4f%s", ratio(s.events.instructions, s.events.cycles),
+                   ratio(s.events.cache_misses, s.pixels), ratio(s.events.branch_misses, s.pixels),
+                   s.events_calling_thread_only ? " *" : "");
+        printf("\n");
+    }
+    if (events && calling_thread_only)
+        printf("* events of the calling thread only, the work of the parallel_for_ threads is not counted\n");
+}
+
+bool Profiler_WriteJSON(const std::string& path)
+{
+    FILE* f = fopen(path.c_str(), "w");
+    if (!f)
+        return false;
+
+    const std::vector<ProfilerStageStats> stats = Profiler_GetStats();
+
+    fprintf(f, "{\n  \"stages\": [\n");
+    for (size_t i = 0; i < stats.size(); i++)
+    {
+        const ProfilerStageStats& s = stats[i];
+        fprintf(f, "    {\"name\": \"%s\", \"calls\": %d, \"total_ms\": %.4f, \"min_ms\": %.4f, "
+                   "\"median_ms\": %.4f, \"p99_ms\": %.4f, \"max_ms\": %.4f, \"pixels\": %lld, "
+                   "\"cycles\": %lld, \"instructions\": %lld, \"cache_misses\": %lld, \"branch_misses\": %lld, "
+                   "\"events_calling_thread_only\": %s, \"allocations\": %lld, \"alloc_bytes\": %lld, \"peak_bytes\": %lld}%s\n",
+                s.name.c_str(), s.calls, s.total_ms, s.min_ms, s.median_ms, s.p99_ms, s.max_ms, (long long)s.pixels,
+                (long long)s.events.cycles, (long long)s.events.instructions,
+                (long long)s.events.cache_misses, (long long)s.events.branch_misses,
+                s.events_calling_thread_only ? "true" : "false",
+                (long long)s.allocations, (long long)s.alloc_bytes, (long long)s.peak_bytes,
+                i + 1 < stats.size() ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+
+    return 0 == fclose(f);
+}
+
+bool Profiler_WriteCSV(const std::string& path)
+{
+    FILE* f = fopen(path.c_str(), "w");
+    if (!f)
+        return false;
+
+    const std::vector<ProfilerStageStats> stats = Profiler_GetStats();
+
+    fprintf(f, "stage,calls,total_ms,min_ms,median_ms,p99_ms,max_ms,pixels,cycles,instructions,cache_misses,branch_misses,"
+               "events_calling_thread_only,allocations,alloc_bytes,peak_bytes\n");
+    for (size_t i = 0; i < stats.size(); i++)
+    {
+        const ProfilerStageStats& s = stats[i];
+        fprintf(f, "%s,%d,%.4f,%.4f,%.4f,%.4f,%.4f,%lld,%lld,%lld,%lld,%lld,%d,%lld,%lld,%lld\n",
+                s.name.c_str(), s.calls, s.total_ms, s.min_ms, s.median_ms, s.p99_ms, s.max_ms, (long long)s.pixels,
+                (long long)s.events.cycles, (long long)s.events.instructions,
+                (long long)s.events.cache_misses, (long long)s.events.branch_misses,
+                s.events_calling_thread_only ? 1 : 0,
+                (long long)s.allocations, (long long)s.alloc_bytes, (long long)s.peak_bytes);
+    }
+
+    return 0 == fclose(f);
+}
@@ -1,88 +1,228 @@
 #include "skeleton_filter.hpp"
+#include "row_kernels.hpp"
 #include <math.h>
 
+#include <vector>
+#include <algorithm>
+
+void ImageResize_rowSources(const cv::Size& src_size, const cv::Size& sz, int row, int& y1, int& y2)
+{
+    const float y = ((float)row + .5f) * src_size.height / sz.height - .5f;
+    const int iy = (int)floor(y);
+    const int src_rows = src_size.height;
+
+    y1 = (iy < 0) ? 0 : ((iy >= src_rows) ? src_rows - 1 : iy);
+    y2 = (iy < 0) ? 0 : ((iy >= src_rows - 1) ? src_rows - 1 : iy + 1);
+}
+
+void ImageResize_row(const uchar* src_y1, const uchar* src_y2, const cv::Size& sz_src,
+                     const cv::Size& sz, int row, uchar* ptr_dst)
+{
+    const int src_rows = sz_src.height;
+    const int src_cols = sz_src.width;
+
+    const int dst_cols = sz.width;
+
+    for (int col = 0; col < dst_cols; col++)
+    {
+        const float x = ((float)col + .5f) * sz_src.width  / sz.width  - .5f;
+        const float y = ((float)row + .5f) * sz_src.height / sz.height - .5f;
+
+        const int ix = (int)floor(x);
+        const int iy = (int)floor(y);
+
+        const int x1 = (ix < 0) ? 0 : ((ix >= src_cols) ? src_cols - 1 : ix);
+        const int x2 = (ix < 0) ? 0 : ((ix >= src_cols - 1) ? src_cols - 1 : ix + 1);
+        const int y1 = (iy < 0) ? 0 : ((iy >= src_rows) ? src_rows - 1 : iy);
+        const int y2 = (iy < 0) ? 0 : ((iy >= src_rows - 1) ? src_rows - 1 : iy + 1);
+
+        const uchar q11 = src_y1[x1];
+        const uchar q12 = src_y2[x1];
+        const uchar q21 = src_y1[x2];
+        const uchar q22 = src_y2[x2];
+
+        const int temp = ((x1 == x2) && (y1 == y2)) ? (int)q11 :
+                         ( (x1 == x2) ? (int)(q11 * (y2 - y) + q22 * (y - y1)) :
+                           ( (y1 == y2) ? (int)(q11 * (x2 - x) + q22 * (x - x1)) : 
+                             (int)(q11 * (x2 - x) * (y2 - y) + q21 * (x - x1) * (y2 - y) + q12 * (x2 - x) * (y - y1) + q22 * (x - x1) * (y - y1))));
+        ptr_dst[col] = (temp < 0) ? 0 : ((temp > 255) ? 255 : (uchar)temp);
+    }
+}
+
 void ImageResize(const cv::Mat &src, cv::Mat &dst, const cv::Size sz)
 {
     CV_Assert(CV_8UC1 == src.type());
     cv::Size sz_src = src.size();
     dst.create(sz, src.type());
 
-    const int src_rows = src.rows;
-    const int src_cols = src.cols;
-
     const int dst_rows = sz.height;
-    const int dst_cols = sz.width;
 
     for (int row = 0; row < dst_rows; row++)
     {
-        uchar *ptr_dst = dst.ptr<uchar>(row);
+        int y1, y2;
+        ImageResize_rowSources(sz_src, sz, row, y1, y2);
+        ImageResize_row(src.ptr<uchar>(y1), src.ptr<uchar>(y2), sz_src, sz, row, dst.ptr<uchar>(row));
+    }
+}
 
-        for (int col = 0; col < dst_cols; col++)
-        {
-            const float x = ((float)col + .5f) * sz_src.width  / sz.width  - .5f;
-            const float y = ((float)row + .5f) * sz_src.height / sz.height - .5f;
-
-            const int ix = (int)floor(x);
-            const int iy = (int)floor(y);
-
-            const int x1 = (ix < 0) ? 0 : ((ix >= src_cols) ? src_cols - 1 : ix);
-            const int x2 = (ix < 0) ? 0 : ((ix >= src_cols - 1) ? src_cols - 1 : ix + 1);
-            const int y1 = (iy < 0) ? 0 : ((iy >= src_rows) ? src_rows - 1 : iy);
-            const int y2 = (iy < 0) ? 0 : ((iy >= src_rows - 1) ? src_rows - 1 : iy + 1);
-
-            const uchar q11 = src.at<uchar>(y1, x1);
-            const uchar q12 = src.at<uchar>(y2, x1);
-            const uchar q21 = src.at<uchar>(y1, x2);
-            const uchar q22 = src.at<uchar>(y2, x2);
-
-            const int temp = ((x1 == x2) && (y1 == y2)) ? (int)q11 :
-                             ( (x1 == x2) ? (int)(q11 * (y2 - y) + q22 * (y - y1)) :
-                               ( (y1 == y2) ? (int)(q11 * (x2 - x) + q22 * (x - x1)) : 
-                                 (int)(q11 * (x2 - x) * (y2 - y) + q21 * (x - x1) * (y2 - y) + q12 * (x2 - x) * (y - y1) + q22 * (x - x1) * (y - y1))));
-            ptr_dst[col] = (temp < 0) ? 0 : ((temp > 255) ? 255 : (uchar)temp);
-        }
+// Fixed-point precision of the interpolation weights
+static const int RESIZE_COEF_BITS  = 11;
+static const int RESIZE_COEF_SCALE = 1 << RESIZE_COEF_BITS;
+
+// For every destination coordinate computes the two source coordinates and
+// their weights exactly as ImageResize does, but only once per column/row
+static void ResizeCoords(int src_len, int dst_len, int* ofs1, int* ofs2, int* coef)
+{
+    for (int i = 0; i < dst_len; i++)
+    {
+        const float f = (((float)i) + .5f) * src_len / dst_len - .5f;
+        const int fi = (int)floor(f);
+
+        const int i1 = (fi < 0) ? 0 : ((fi >= src_len) ? src_len - 1 : fi);
+        const int i2 = (fi < 0) ? 0 : ((fi >= src_len - 1) ? src_len - 1 : fi + 1);
+
+        // When both coordinates are clamped to the same one the second weight is unused
+        const int w2 = (i1 == i2) ? 0 : cvRound((f - i1) * RESIZE_COEF_SCALE);
+
+        ofs1[i] = i1;
+        ofs2[i] = i2;
+        coef[2*i]     = RESIZE_COEF_SCALE - w2;
+        coef[2*i + 1] = w2;
     }
 }
 
+static void ResizeRow(const uchar* src, int* dst, int dst_cols,
+                      const int* xofs1, const int* xofs2, const int* alpha)
+{
+    for (int col = 0; col < dst_cols; col++)
+        dst[col] = src[xofs1[col]] * alpha[2*col] + src[xofs2[col]] * alpha[2*col + 1];
+}
+
 void ImageResize_optimized(const cv::Mat &src, cv::Mat &dst, const cv::Size sz)
 {
     CV_Assert(CV_8UC1 == src.type());
     cv::Size sz_src = src.size();
     dst.create(sz, src.type());
 
-    const int src_rows = src.rows;
-    const int src_cols = src.cols;
-
     const int dst_rows = sz.height;
     const int dst_cols = sz.width;
 
+    std::vector<int> xofs1(dst_cols), xofs2(dst_cols), alpha(2 * dst_cols);
+    std::vector<int> yofs1(dst_rows), yofs2(dst_rows), beta(2 * dst_rows);
+    if (dst_cols > 0)
+        ResizeCoords(sz_src.width, dst_cols, &xofs1[0], &xofs2[0], &alpha[0]);
+    if (dst_rows > 0)
+        ResizeCoords(sz_src.height, dst_rows, &yofs1[0], &yofs2[0], &beta[0]);
+
+    // Horizontally interpolated source rows, reused by consecutive destination rows
+    std::vector<int> buffer(2 * dst_cols + 2);
+    int* hrows[2] = { &buffer[0], &buffer[dst_cols + 1] };
+    int hidx[2] = { -1, -1 };
+
+    const int shift = 2 * RESIZE_COEF_BITS;
+
     for (int row = 0; row < dst_rows; row++)
     {
+        if (hidx[0] != yofs1[row])
+        {
+            if (hidx[1] == yofs1[row])
+            {
+                std::swap(hrows[0], hrows[1]);
+                std::swap(hidx[0], hidx[1]);
+            }
+            else
+            {
+                ResizeRow(src.ptr<uchar>(yofs1[row]), hrows[0], dst_cols, &xofs1[0], &xofs2[0], &alpha[0]);
+                hidx[0] = yofs1[row];
+            }
+        }
+        if (hidx[1] != yofs2[row])
+        {
+            ResizeRow(src.ptr<uchar>(yofs2[row]), hrows[1], dst_cols, &xofs1[0], &xofs2[0], &alpha[0]);
+            hidx[1] = yofs2[row];
+        }
+
+        const int b1 = beta[2*row], b2 = beta[2*row + 1];
+        const int* h1 = hrows[0];
+        const int* h2 = hrows[1];
         uchar *ptr_dst = dst.ptr<uchar>(row);
 
         for (int col = 0; col < dst_cols; col++)
         {
-            const float x = (((float)col) + .5f) * sz_src.width  / sz.width  - .5f;
-            const float y = (((float)row) + .5f) * sz_src.height / sz.height - .5f;
-
-            const int ix = (int)floor(x);
-            const int iy = (int)floor(y);
-
-            const int x1 = (ix < 0) ? 0 : ((ix >= src_cols) ? src_cols - 1 : ix);
-            const int x2 = (ix < 0) ? 0 : ((ix >= src_cols - 1) ? src_cols - 1 : ix + 1);
-            const int y1 = (iy < 0) ? 0 : ((iy >= src_rows) ? src_rows - 1 : iy);
-            const int y2 = (iy < 0) ? 0 : ((iy >= src_rows - 1) ? src_rows - 1 : iy + 1);
-
-            const uchar q11 = src.at<uchar>(y1, x1);
-            const uchar q12 = src.at<uchar>(y2, x1);
-            const uchar q21 = src.at<uchar>(y1, x2);
-            const uchar q22 = src.at<uchar>(y2, x2);
-
-            const int temp = ((x1 == x2) && (y1 == y2)) ? (int)q11 :
-              ( (x1 == x2) ? (int)(q11 * (y2 - y) + q22 * (y - y1)) :
-              ( (y1 == y2) ? (int)(q11 * (x2 - x) + q22 * (x - x1)) : 
-              (int)(q11 * (x2 - x) * (y2 - y) + q21 * (x - x1) * (y2 - y) + q12 * (x2 - x) * (y - y1) + q22 * (x - x1) * (y - y1))));
-            ptr_dst[col] = (temp < 0) ? 0 : ((temp > 255) ? 255 : (uchar)temp);
+            // Truncation instead of rounding, the same as in ImageResize
+            const int temp = (h1[col] * b1 + h2[col] * b2) >> shift;
+            ptr_dst[col] = (temp > 255) ? 255 : (uchar)temp;
         }
     }
 }
+
+//
+// Specialised version for the pipeline's 1 / 1.5 ratio
+//
+
+// With src = 3 * k and dst = 2 * k every pair of destination pixels maps onto
+// three source pixels with the fixed weights (3/4, 1/4) and (1/4, 3/4), and no
+// clamping is ever needed. Products of such weights are exact in float, so
+// ImageResize yields floor(sum / 16) of the integer sums computed here.
+//
+// ImageResize gets these weights only while its float source coordinate
+// (i + .5) * src / dst is exact, i.e. (2 * dst - 1) * src has at most
+// 24 significant bits. Larger images are left to the reference.
+static bool CoordinatesExact(int src, int dst)
+{
+    while (src > 0 && src % 2 == 0)
+        src /= 2;
+    return (int64)(2 * dst - 1) * src < (1 << 24);
+}
+
+bool ImageResize_3to2_supported(const cv::Size& src, const cv::Size& dst)
+{
+    return src.width == dst.width * 3 / 2 && dst.width % 2 == 0 &&
+           src.height == dst.height * 3 / 2 && dst.height % 2 == 0 &&
+           dst.width > 0 && dst.height > 0 &&
+           CoordinatesExact(src.width, dst.width) &&
+           CoordinatesExact(src.height, dst.height);
+}
+
+static void Decimate3to2Row(const ushort* v, uchar* dst, int dst_cols)
+{
+    for (int col = 0, x = 0; col < dst_cols; col += 2, x += 3)
+    {
+        dst[col]     = (uchar)((3 * v[x] + v[x+1]) >> 4);
+        dst[col + 1] = (uchar)((v[x+1] + 3 * v[x+2]) >> 4);
+    }
+}
+
+void ImageResize_3to2_rows(const uchar* s0, const uchar* s1, const uchar* s2, int src_cols,
+                           ushort* buffer, uchar* d0, uchar* d1)
+{
+    // Vertically combined rows for both output phases
+    ushort* v0 = buffer;
+    ushort* v1 = buffer + src_cols;
+
+    // Plain element-wise loop, the compiler vectorizes it
+    for (int x = 0; x < src_cols; x++)
+    {
+        v0[x] = (ushort)(3 * s0[x] + s1[x]);
+        v1[x] = (ushort)(s1[x] + 3 * s2[x]);
+    }
+
+    Decimate3to2Row(v0, d0, src_cols * 2 / 3);
+    Decimate3to2Row(v1, d1, src_cols * 2 / 3);
+}
+
+void ImageResize_3to2(const cv::Mat &src, cv::Mat &dst)
+{
+    CV_Assert(CV_8UC1 == src.type());
+    const cv::Size sz(src.cols * 2 / 3, src.rows * 2 / 3);
+    CV_Assert(ImageResize_3to2_supported(src.size(), sz));
+    dst.create(sz, src.type());
+
+    std::vector<ushort> buffer(2 * src.cols);
+
+    for (int row = 0, y = 0; row < sz.height; row += 2, y += 3)
+    {
+        ImageResize_3to2_rows(src.ptr<uchar>(y), src.ptr<uchar>(y + 1), src.ptr<uchar>(y + 2), src.cols,
+                              &buffer[0], dst.ptr<uchar>(row), dst.ptr<uchar>(row + 1));
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "opencv2/core/core.hpp"
+
+#include <vector>
+
+// Row-level building blocks of the pipeline stages. The whole-image functions
+// from skeleton_filter.hpp are implemented on top of them, so any front-end
+// built from these rows produces exactly the same values.
+
+void ConvertColor_BGR2GRAY_BT709_row(const uchar* src, uchar* dst, int width);
+
+// Source rows y1 and y2 which destination row 'row' of ImageResize reads
+void ImageResize_rowSources(const cv::Size& src_size, const cv::Size& sz, int row, int& y1, int& y2);
+void ImageResize_row(const uchar* src_y1, const uchar* src_y2, const cv::Size& src_size,
+                     const cv::Size& sz, int row, uchar* dst);
+
+// Three source rows into two destination rows, 'buffer' holds 2 * src_cols elements
+void ImageResize_3to2_rows(const uchar* s0, const uchar* s1, const uchar* s2, int src_cols,
+                           ushort* buffer, uchar* d0, uchar* d1);
+
+// Versions of the stages with caller-owned scratch buffers. Once the buffers
+// have grown to the image width, repeated calls do not allocate anything.
+void ConvertResizeThreshold_fused(const cv::Mat& input, cv::Mat& binary, const cv::Size small_size,
+                                  std::vector<uchar>& gray, std::vector<ushort>& buffer);
+void GuoHallThinning_optimized(const cv::Mat& src, cv::Mat& dst, std::vector<uchar>& scratch);
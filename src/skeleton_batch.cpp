@@ -0,0 +1,79 @@
+#include "skeleton_filter.hpp"
+
+#include "opencv2/highgui/highgui.hpp"
+
+// Every worker takes the next unprocessed image from the shared counter and
+// runs it through its own SkeletonPipeline, which is reused while the input
+// size does not change. Outputs are written by index, so the order is kept.
+// The pipeline's kernels are fixed, the selection in the registry is not
+// read, so workers never depend on a global that another thread may change.
+class SkeletonBatchBody : public cv::ParallelLoopBody
+{
+public:
+    SkeletonBatchBody(const std::vector<cv::Mat>* inputs, const std::vector<std::string>* paths,
+                      std::vector<cv::Mat>& outputs, int* next)
+        : inputs_(inputs), paths_(paths), outputs_(outputs), next_(next) {}
+
+    void operator()(const cv::Range& range) const
+    {
+        const int count = (int)outputs_.size();
+
+        for (int worker = range.start; worker < range.end; worker++)
+        {
+            cv::Ptr<SkeletonPipeline> pipeline;
+
+            for (;;)
+            {
+                const int i = CV_XADD(next_, 1);
+                if (i >= count)
+                    break;
+
+                const cv::Mat input = inputs_ ? (*inputs_)[i] : cv::imread((*paths_)[i]);
+                if (input.empty())
+                    continue;
+
+                if (pipeline.empty() || pipeline->inputSize() != input.size())
+                    pipeline = new SkeletonPipeline(input.size());
+
+                pipeline->process(input, outputs_[i]);
+            }
+        }
+    }
+
+private:
+    const std::vector<cv::Mat>* inputs_;
+    const std::vector<std::string>* paths_;
+    std::vector<cv::Mat>& outputs_;
+    int* next_;
+};
+
+static void runBatch(const std::vector<cv::Mat>* inputs, const std::vector<std::string>* paths,
+                     size_t count, std::vector<cv::Mat>& outputs, int nthreads)
+{
+    if (nthreads <= 0)
+        nthreads = cv::getNumThreads();
+
+    outputs.assign(count, cv::Mat());
+
+    // One stripe per worker, so no more than 'workers' threads of the
+    // OpenCV pool take part and its global setting stays untouched
+    int next = 0;
+    const int workers = std::max(1, std::min(nthreads, (int)count));
+    if (workers > 1)
+        Profiler_NoteOtherThreads();
+    cv::parallel_for_(cv::Range(0, workers), SkeletonBatchBody(inputs, paths, outputs, &next), workers);
+}
+
+void skeletonize_batch(const std::vector<cv::Mat>& inputs, std::vector<cv::Mat>& outputs, int nthreads)
+{
+    // Checked here because exceptions must not escape the worker threads
+    for (size_t i = 0; i < inputs.size(); i++)
+        CV_Assert(inputs[i].empty() || CV_8UC3 == inputs[i].type());
+
+    runBatch(&inputs, 0, inputs.size(), outputs, nthreads);
+}
+
+void skeletonize_batch(const std::vector<std::string>& paths, std::vector<cv::Mat>& outputs, int nthreads)
+{
+    runBatch(0, &paths, paths.size(), outputs, nthreads);
+}
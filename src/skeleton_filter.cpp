@@ -1,39 +1,153 @@
 #include "skeleton_filter.hpp"
+#include "row_kernels.hpp"
 
 #include "opencv2/imgproc/imgproc.hpp"
-#include "opencv2/highgui/highgui.hpp"
 
-void skeletonize(const cv::Mat &input, cv::Mat &output, bool save_images)
+// Tuning of a new size is not a part of the pipeline's time. The kernels
+// are kept for every tuned size and passed down the call, so calls with
+// different sizes on other threads do not change each other's kernels.
+static KernelSet autotunedKernels(const cv::Size& size)
 {
-    TS(total);
+    static cv::Mutex mutex;
+    static std::vector<std::pair<cv::Size, KernelSet> > tuned;
 
-    TS(imwrite_0);
-    if (save_images) cv::imwrite("0-input.png", input);
-    TE(imwrite_0);
+    cv::AutoLock lock(mutex);
+    for (size_t i = 0; i < tuned.size(); i++)
+    {
+        if (tuned[i].first == size)
+            return tuned[i].second;
+    }
+    KernelSet kernels;
+    Kernels_Autotune(size, kernels);
+    tuned.push_back(std::make_pair(size, kernels));
+    return kernels;
+}
+
+void skeletonize(const cv::Mat &input, cv::Mat &output, bool save_images, bool fused_frontend)
+{
+    const KernelSet kernels = !fused_frontend && Kernels_AutotuneEnabled() ?
+                              autotunedKernels(input.size()) : Kernels_SelectedSet();
+
+    PROFILE_SCOPE_PIXELS(skeletonize, input.total());
 
-    // Convert to grayscale
-    cv::Mat gray_image;
-    ConvertColor_BGR2GRAY_BT709(input, gray_image);
-    if (save_images) cv::imwrite("1-convertcolor.png", gray_image);
+    if (save_images)
+    {
+        PROFILE_SCOPE(imwrite);
+        ImageWriter_Write("0-input.png", input);
+    }
 
-    // Downscale input image
+    // Buffers of the intermediate images are reused between the calls
     cv::Mat small_image;
+    small_image.allocator = MatPool_Allocator();
     cv::Size small_size(input.cols / 1.5, input.rows / 1.5);
-    ImageResize(gray_image, small_image, small_size);
-    if (save_images) cv::imwrite("2-resize.png", small_image);
 
-    // Binarization and inversion
-    cv::threshold(small_image, small_image, 128, 255, cv::THRESH_BINARY_INV);
-    if (save_images) cv::imwrite("3-threshold.png", small_image);
+    if (fused_frontend)
+    {
+        // Grayscale, downscale and binarization row by row,
+        // the full-size gray image is never created
+        PROFILE_SCOPE_PIXELS(frontend_fused, input.total());
+        ConvertResizeThreshold_fused(input, small_image, small_size);
+    }
+    else
+    {
+        // Convert to grayscale
+        cv::Mat gray_image;
+        gray_image.allocator = MatPool_Allocator();
+        {
+            PROFILE_SCOPE_PIXELS(convertcolor, input.total());
+            kernels.convert(input, gray_image);
+        }
+        if (save_images)
+        {
+            PROFILE_SCOPE(imwrite);
+            ImageWriter_Write("1-convertcolor.png", gray_image);
+        }
+
+        // Downscale input image
+        {
+            PROFILE_SCOPE_PIXELS(resize, input.total());
+            kernels.resize(gray_image, small_image, small_size);
+        }
+        if (save_images)
+        {
+            PROFILE_SCOPE(imwrite);
+            ImageWriter_Write("2-resize.png", small_image);
+        }
+
+        // Binarization and inversion
+        PROFILE_SCOPE_PIXELS(threshold, small_size.area());
+        cv::threshold(small_image, small_image, 128, 255, cv::THRESH_BINARY_INV);
+    }
+    if (save_images)
+    {
+        PROFILE_SCOPE(imwrite);
+        ImageWriter_Write("3-threshold.png", small_image);
+    }
 
     // Thinning
     cv::Mat thinned_image;
-    GuoHallThinning(small_image, thinned_image);
-    if (save_images) cv::imwrite("4-thinning.png", thinned_image);
+    thinned_image.allocator = MatPool_Allocator();
+    {
+        PROFILE_SCOPE_PIXELS(thinning, small_size.area());
+        kernels.thinning(small_image, thinned_image);
+    }
+    if (save_images)
+    {
+        PROFILE_SCOPE(imwrite);
+        ImageWriter_Write("4-thinning.png", thinned_image);
+    }
 
     // Back inversion
-    output = 255 - thinned_image;
-    if (save_images) cv::imwrite("5-output.png", output);
+    {
+        PROFILE_SCOPE_PIXELS(inversion, small_size.area());
+        output = 255 - thinned_image;
+    }
+    if (save_images)
+    {
+        PROFILE_SCOPE(imwrite);
+        ImageWriter_Write("5-output.png", output);
+    }
+}
+
+SkeletonPipeline::SkeletonPipeline(const cv::Size& input_size)
+    : input_size_(input_size),
+      small_size_(input_size.width / 1.5, input_size.height / 1.5),
+      gray_rows_(3 * input_size.width + 1),
+      resize_rows_(2 * input_size.width + 1),
+      thinning_rows_(2 * small_size_.width)
+{
+    // Counted like the other image buffers
+    small_image_.allocator = Memory_MatAllocator();
+    small_image_.create(small_size_, CV_8UC1);
+    thinned_image_.allocator = Memory_MatAllocator();
+    thinned_image_.create(small_size_, CV_8UC1);
+}
+
+void SkeletonPipeline::process(const cv::Mat& input, cv::Mat& output)
+{
+    CV_Assert(CV_8UC3 == input.type() && input.size() == input_size_);
+    PROFILE_SCOPE_PIXELS(pipeline, input.total());
+
+    // Grayscale, downscale and binarization
+    {
+        PROFILE_SCOPE_PIXELS(frontend_fused, input.total());
+        ConvertResizeThreshold_fused(input, small_image_, small_size_, gray_rows_, resize_rows_);
+    }
+
+    // Thinning
+    {
+        PROFILE_SCOPE_PIXELS(thinning_optimized, small_size_.area());
+        GuoHallThinning_optimized(small_image_, thinned_image_, thinning_rows_);
+    }
 
-    TE(total);
+    // Back inversion, written straight into the caller's buffer
+    PROFILE_SCOPE_PIXELS(inversion, small_size_.area());
+    output.create(small_size_, CV_8UC1);
+    for (int y = 0; y < small_size_.height; y++)
+    {
+        const uchar* pthinned = thinned_image_.ptr<uchar>(y);
+        uchar* poutput = output.ptr<uchar>(y);
+        for (int x = 0; x < small_size_.width; x++)
+            poutput[x] = 255 - pthinned[x];
+    }
 }
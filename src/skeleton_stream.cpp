@@ -0,0 +1,460 @@
+#include "skeleton_filter.hpp"
+#include "row_kernels.hpp"
+#include "threads.hpp"
+
+#include "opencv2/imgproc/imgproc.hpp"
+
+//
+// Bounded single-producer/single-consumer queue of preallocated frames
+//
+
+struct StreamFrame
+{
+    cv::Mat image;
+    int64 push_ticks;   // when the frame entered the stream
+};
+
+// Only the producer moves 'tail_' and only the consumer moves 'head_'.
+// CV_XADD is a full barrier, so it both publishes a slot and reads the
+// other side's index. A waiting thread yields for a short while and then
+// blocks on the monitor, so idle stages do not keep the CPU busy.
+// The other side takes the monitor only when someone is blocked on it.
+class FrameQueue
+{
+public:
+    explicit FrameQueue(int capacity)
+        : slots_(capacity), head_(0), tail_(0), closed_(0), aborted_(0), waiters_(0) {}
+
+    // Free slot to fill, NULL if the stream is being destroyed
+    StreamFrame* beginPush()
+    {
+        if (!waitFor(&FrameQueue::canPush, false))
+            return NULL;
+        return &slots_[tail_ % slots_.size()];
+    }
+    void endPush() { CV_XADD(&tail_, 1); wakeUp(); }
+
+    // Oldest filled slot, NULL when the queue is closed and drained
+    StreamFrame* beginPop()
+    {
+        if (!waitFor(&FrameQueue::canPop, true))
+            return NULL;
+        return &slots_[head_ % slots_.size()];
+    }
+    void endPop() { CV_XADD(&head_, 1); wakeUp(); }
+
+    // No more frames will be pushed
+    void close() { CV_XADD(&closed_, 1); wakeUp(); }
+    // Wake up both sides for shutdown
+    void abort() { CV_XADD(&aborted_, 1); wakeUp(); }
+
+    int depth() const { return load(&tail_) - load(&head_); }
+
+private:
+    // Yields before a thread blocks, a frame usually arrives within a few
+    static const int SPIN_COUNT = 64;
+
+    static int load(const int* value) { return CV_XADD((int*)value, 0); }
+
+    bool canPush() const { return load(&tail_) - load(&head_) < (int)slots_.size(); }
+    bool canPop() const { return load(&tail_) != load(&head_); }
+
+    // Shutdown or, for the consumer, a closed and drained queue
+    bool stopped(bool consumer) const
+    {
+        return load(&aborted_) || (consumer && load(&closed_) && !canPop());
+    }
+
+    // True once 'ready' holds, false when the waiting side is stopped
+    bool waitFor(bool (FrameQueue::*ready)() const, bool consumer)
+    {
+        for (int spin = 0; ; spin++)
+        {
+            if ((this->*ready)())
+                return true;
+            if (stopped(consumer))
+                return false;
+            if (spin == SPIN_COUNT)
+                break;
+            yieldThread();
+        }
+
+        monitor_.lock();
+        CV_XADD(&waiters_, 1);
+        bool result;
+        for (;;)
+        {
+            if ((this->*ready)())
+            {
+                result = true;
+                break;
+            }
+            if (stopped(consumer))
+            {
+                result = false;
+                break;
+            }
+            monitor_.wait();
+        }
+        CV_XADD(&waiters_, -1);
+        monitor_.unlock();
+        return result;
+    }
+
+    void wakeUp()
+    {
+        if (load(&waiters_) == 0)
+            return;
+        monitor_.lock();
+        monitor_.notifyAll();
+        monitor_.unlock();
+    }
+
+    std::vector<StreamFrame> slots_;
+    int head_;
+    int tail_;
+    int closed_;
+    int aborted_;
+
+    ThreadMonitor monitor_;
+    int waiters_;
+};
+
+//
+// Stages
+//
+
+struct SkeletonStream::Impl
+{
+    Impl(const cv::Size& input_size, int queue_capacity);
+
+    void convertStage();
+    void resizeStage();
+    void thinningStage();
+
+    static void runConvertStage(void* impl)  { ((Impl*)impl)->runStage(&Impl::convertStage); }
+    static void runResizeStage(void* impl)   { ((Impl*)impl)->runStage(&Impl::resizeStage); }
+    static void runThinningStage(void* impl) { ((Impl*)impl)->runStage(&Impl::thinningStage); }
+
+    // An exception must not leave a stage thread, it would terminate the process
+    void runStage(void (Impl::*stage)());
+    void fail(const char* what);
+    void abortQueues();
+    void throwIfFailed();
+
+    cv::Size input_size;
+    cv::Size small_size;
+
+    // Between the caller, the stage threads and the caller again
+    FrameQueue input_queue;
+    FrameQueue gray_queue;
+    FrameQueue binary_queue;
+    FrameQueue output_queue;
+
+    // Per-stage buffers, each touched by one thread only
+    std::vector<ushort> resize_rows;
+    std::vector<uchar> thinning_rows;
+    cv::Mat thinned_image;
+
+    ThreadStart starts[3];
+    ThreadHandle threads[3];
+    bool closed;
+
+    // The first error of a stage, reported to the caller by push(), pop() and close()
+    cv::Mutex error_mutex;
+    std::string error;
+
+    // Updated by pop(), read by stats() from any thread
+    cv::Mutex stats_mutex;
+    SkeletonStreamStats stats;
+};
+
+SkeletonStream::Impl::Impl(const cv::Size& sz, int queue_capacity)
+    : input_size(sz),
+      small_size(sz.width / 1.5, sz.height / 1.5),
+      input_queue(queue_capacity),
+      gray_queue(queue_capacity),
+      binary_queue(queue_capacity),
+      output_queue(queue_capacity),
+      resize_rows(2 * sz.width + 1),
+      thinning_rows(2 * small_size.width),
+      thinned_image(small_size, CV_8UC1),
+      closed(false)
+{
+}
+
+void SkeletonStream::Impl::runStage(void (Impl::*stage)())
+{
+    try
+    {
+        (this->*stage)();
+    }
+    catch (const std::exception& e)
+    {
+        fail(e.what());
+    }
+    catch (...)
+    {
+        fail("unknown exception");
+    }
+}
+
+// The other stages and a caller blocked in push() or pop() are woken up by the abort
+void SkeletonStream::Impl::fail(const char* what)
+{
+    {
+        cv::AutoLock lock(error_mutex);
+        if (error.empty())
+            error = what;
+    }
+    abortQueues();
+}
+
+void SkeletonStream::Impl::abortQueues()
+{
+    input_queue.abort();
+    gray_queue.abort();
+    binary_queue.abort();
+    output_queue.abort();
+}
+
+void SkeletonStream::Impl::throwIfFailed()
+{
+    std::string message;
+    {
+        cv::AutoLock lock(error_mutex);
+        message = error;
+    }
+    if (!message.empty())
+        CV_Error(CV_StsError, "A stage of the stream failed: " + message);
+}
+
+void SkeletonStream::Impl::convertStage()
+{
+    for (;;)
+    {
+        StreamFrame* in = input_queue.beginPop();
+        if (!in)
+            break;
+        StreamFrame* out = gray_queue.beginPush();
+        if (!out)
+            return;
+
+        {
+            PROFILE_SCOPE_PIXELS(convertcolor, input_size.area());
+            ConvertColor_BGR2GRAY_BT709(in->image, out->image);
+        }
+        out->push_ticks = in->push_ticks;
+
+        input_queue.endPop();
+        gray_queue.endPush();
+    }
+    gray_queue.close();
+}
+
+void SkeletonStream::Impl::resizeStage()
+{
+    const bool resize_3to2 = ImageResize_3to2_supported(input_size, small_size);
+
+    for (;;)
+    {
+        StreamFrame* in = gray_queue.beginPop();
+        if (!in)
+            break;
+        StreamFrame* out = binary_queue.beginPush();
+        if (!out)
+            return;
+
+        const cv::Mat& gray = in->image;
+        cv::Mat& small_image = out->image;
+        small_image.create(small_size, CV_8UC1);
+
+        // Downscale
+        PROFILE_SCOPE_PIXELS(resize_threshold, input_size.area());
+        if (resize_3to2)
+        {
+            for (int row = 0, y = 0; row < small_size.height; row += 2, y += 3)
+            {
+                ImageResize_3to2_rows(gray.ptr<uchar>(y), gray.ptr<uchar>(y + 1), gray.ptr<uchar>(y + 2), gray.cols,
+                                      &resize_rows[0], small_image.ptr<uchar>(row), small_image.ptr<uchar>(row + 1));
+            }
+        }
+        else
+        {
+            ImageResize(gray, small_image, small_size);
+        }
+
+        // Binarization and inversion
+        cv::threshold(small_image, small_image, 128, 255, cv::THRESH_BINARY_INV);
+        out->push_ticks = in->push_ticks;
+
+        gray_queue.endPop();
+        binary_queue.endPush();
+    }
+    binary_queue.close();
+}
+
+void SkeletonStream::Impl::thinningStage()
+{
+    for (;;)
+    {
+        StreamFrame* in = binary_queue.beginPop();
+        if (!in)
+            break;
+        StreamFrame* out = output_queue.beginPush();
+        if (!out)
+            return;
+
+        {
+            PROFILE_SCOPE_PIXELS(thinning_optimized, small_size.area());
+            GuoHallThinning_optimized(in->image, thinned_image, thinning_rows);
+        }
+
+        // Back inversion, the thinned image holds only 0 and 255
+        {
+            PROFILE_SCOPE_PIXELS(inversion, small_size.area());
+            cv::bitwise_not(thinned_image, out->image);
+        }
+        out->push_ticks = in->push_ticks;
+
+        binary_queue.endPop();
+        output_queue.endPush();
+    }
+    output_queue.close();
+}
+
+//
+// Public interface
+//
+
+SkeletonStream::SkeletonStream(const cv::Size& input_size, int queue_capacity)
+    : impl_(new Impl(input_size, queue_capacity))
+{
+    CV_Assert(queue_capacity > 0);
+
+    const ThreadFunc funcs[3] = { Impl::runConvertStage, Impl::runResizeStage, Impl::runThinningStage };
+    for (int i = 0; i < 3; i++)
+    {
+        impl_->starts[i].func = funcs[i];
+        impl_->starts[i].arg = impl_;
+        startThread(impl_->threads[i], &impl_->starts[i]);
+    }
+}
+
+SkeletonStream::~SkeletonStream()
+{
+    // Frames still in flight are dropped
+    impl_->abortQueues();
+
+    for (int i = 0; i < 3; i++)
+        joinThread(impl_->threads[i]);
+
+    delete impl_;
+}
+
+cv::Size SkeletonStream::inputSize() const
+{
+    return impl_->input_size;
+}
+
+cv::Size SkeletonStream::outputSize() const
+{
+    return impl_->small_size;
+}
+
+bool SkeletonStream::push(const cv::Mat& frame)
+{
+    CV_Assert(CV_8UC3 == frame.type() && frame.size() == impl_->input_size);
+    CV_Assert(!impl_->closed);
+
+    StreamFrame* slot = impl_->input_queue.beginPush();
+    if (!slot)
+    {
+        impl_->throwIfFailed();
+        return false;
+    }
+
+    // Copied into the slot's own buffer, the caller may reuse 'frame' at once
+    frame.copyTo(slot->image);
+    slot->push_ticks = cv::getTickCount();
+
+    impl_->input_queue.endPush();
+    return true;
+}
+
+bool SkeletonStream::pop(cv::Mat& output)
+{
+    StreamFrame* slot = impl_->output_queue.beginPop();
+    if (!slot)
+    {
+        impl_->throwIfFailed();
+        return false;
+    }
+
+    slot->image.copyTo(output);
+    const double latency = 1000. * (cv::getTickCount() - slot->push_ticks) / cv::getTickFrequency();
+
+    impl_->output_queue.endPop();
+
+    cv::AutoLock lock(impl_->stats_mutex);
+    SkeletonStreamStats& stats = impl_->stats;
+    stats.latency_ms = latency;
+    stats.max_latency_ms = std::max(stats.max_latency_ms, latency);
+    stats.mean_latency_ms += (latency - stats.mean_latency_ms) / (stats.frames + 1);
+    stats.frames++;
+    return true;
+}
+
+void SkeletonStream::close()
+{
+    if (!impl_->closed)
+        impl_->input_queue.close();
+    impl_->closed = true;
+    impl_->throwIfFailed();
+}
+
+SkeletonStreamStats SkeletonStream::stats() const
+{
+    SkeletonStreamStats stats;
+    {
+        cv::AutoLock lock(impl_->stats_mutex);
+        stats = impl_->stats;
+    }
+    stats.queue_depth[0] = impl_->input_queue.depth();
+    stats.queue_depth[1] = impl_->gray_queue.depth();
+    stats.queue_depth[2] = impl_->binary_queue.depth();
+    stats.queue_depth[3] = impl_->output_queue.depth();
+    return stats;
+}
+
+SkeletonStreamStats::SkeletonStreamStats()
+    : frames(0), latency_ms(0), mean_latency_ms(0), max_latency_ms(0)
+{
+    for (int i = 0; i < 4; i++)
+        queue_depth[i] = 0;
+}
+
+//
+// Synthetic camera
+//
+
+void GenerateSyntheticFrame(cv::Mat& frame, const cv::Size& size, int index)
+{
+    frame.create(size, CV_8UC3);
+    frame.setTo(cv::Scalar(235, 240, 245));
+
+    // The same strokes on every call, shifted a little with each frame
+    cv::RNG rng(0x5eed);
+    const int shift = index % 32;
+    const int strokes = std::max(1, size.area() / 4000);
+    const int thickness = std::max(2, size.height / 120);
+
+    for (int i = 0; i < strokes; i++)
+    {
+        cv::Point p1(rng.uniform(0, size.width) + shift, rng.uniform(0, size.height));
+        cv::Point p2(p1.x + rng.uniform(-size.width / 20, size.width / 20) - 1,
+                     p1.y + rng.uniform(-size.height / 20, size.height / 20) - 1);
+        const cv::Scalar ink(rng.uniform(0, 90), rng.uniform(0, 90), rng.uniform(0, 90));
+        cv::line(frame, p1, p2, ink, thickness);
+    }
+}
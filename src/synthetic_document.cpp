@@ -0,0 +1,84 @@
+#include "skeleton_filter.hpp"
+
+#include "opencv2/imgproc/imgproc.hpp"
+
+// Glyph made of 1-3 strokes between the nodes of a 3x3 grid in its box
+static void drawGlyph(cv::Mat& image, cv::RNG& rng, const cv::Rect& box, int stroke_width)
+{
+    const int strokes = rng.uniform(1, 4);
+    for (int i = 0; i < strokes; i++)
+    {
+        const cv::Point p1(box.x + box.width * rng.uniform(0, 3) / 2, box.y + box.height * rng.uniform(0, 3) / 2);
+        const cv::Point p2(box.x + box.width * rng.uniform(0, 3) / 2, box.y + box.height * rng.uniform(0, 3) / 2);
+        cv::line(image, p1, p2, cv::Scalar::all(255), stroke_width);
+    }
+}
+
+static void drawWord(cv::Mat& image, cv::RNG& rng, int stroke_width)
+{
+    const int height = 6 * stroke_width + 4;
+    const int width = height * 3 / 5;
+    const int glyphs = rng.uniform(2, 9);
+
+    cv::Rect box(rng.uniform(0, image.cols), rng.uniform(0, image.rows), width, height);
+    for (int i = 0; i < glyphs; i++)
+    {
+        drawGlyph(image, rng, box, stroke_width);
+        box.x += width + 2 * stroke_width;
+    }
+}
+
+// Horizontal or vertical rule, as in tables and forms
+static void drawRule(cv::Mat& image, cv::RNG& rng, int stroke_width)
+{
+    const cv::Point p1(rng.uniform(0, image.cols), rng.uniform(0, image.rows));
+    cv::Point p2 = p1;
+    if (rng.uniform(0, 2))
+        p2.x += rng.uniform(image.cols / 8, image.cols / 2 + 1);
+    else
+        p2.y += rng.uniform(image.rows / 8, image.rows / 2 + 1);
+    cv::line(image, p1, p2, cv::Scalar::all(255), 2 * stroke_width);
+}
+
+// Filled blob, as stamps, logos and bullets
+static void drawBlob(cv::Mat& image, cv::RNG& rng, int stroke_width)
+{
+    const cv::Point center(rng.uniform(0, image.cols), rng.uniform(0, image.rows));
+    cv::circle(image, center, stroke_width * rng.uniform(2, 6), cv::Scalar::all(255), -1);
+}
+
+void GenerateSyntheticDocument(cv::Mat& binary, const cv::Size& size, int stroke_width, double density, int seed)
+{
+    CV_Assert(size.width > 0 && size.height > 0);
+    CV_Assert(stroke_width >= 1 && 0 < density && density < 1);
+
+    binary.create(size, CV_8UC1);
+    binary.setTo(cv::Scalar::all(0));
+
+    cv::RNG rng(0xd0c5eedULL + seed);
+    const int target = cvRound(density * size.area());
+    int filled = 0;
+    int elements = 0;
+
+    // Elements are drawn in batches sized by the coverage of the previous
+    // ones, the overlaps make the count only approximate
+    for (int round = 0; round < 64 && filled < target; round++)
+    {
+        const double per_element = elements ? std::max(1., (double)filled / elements) : 0;
+        const int batch = per_element ? std::max(1, (int)((target - filled) / per_element / 2)) : 1;
+
+        for (int i = 0; i < batch; i++)
+        {
+            // Mostly text, with some rules and blobs
+            const int kind = rng.uniform(0, 10);
+            if (kind < 7)
+                drawWord(binary, rng, stroke_width);
+            else if (kind < 9)
+                drawRule(binary, rng, stroke_width);
+            else
+                drawBlob(binary, rng, stroke_width);
+        }
+        elements += batch;
+        filled = cv::countNonZero(binary);
+    }
+}
@@ -1,6 +1,19 @@
 #include "skeleton_filter.hpp"
+#include "row_kernels.hpp"
 #include <opencv2/imgproc/imgproc.hpp>
 
+#include <vector>
+#include <algorithm>
+#include <string.h>
+
+// Scratch images come from the pool of image buffers, they are
+// reused between the iterations and counted with the stage
+static void createScratch(cv::Mat& m, const cv::Size& size)
+{
+    m.allocator = MatPool_Allocator();
+    m.create(size, CV_8UC1);
+}
+
 static void GuoHallIteration(cv::Mat& im, int iter)
 {
     cv::Mat marker = cv::Mat::zeros(im.size(), CV_8UC1);
@@ -58,22 +71,35 @@ void GuoHallThinning(const cv::Mat& src, cv::Mat& dst)
 // Place optimized version here
 //
 
-static void GuoHallIteration_optimized(cv::Mat& im, int iter)
+// Works directly on 0/255 images and uses 'up' and 'del' rows of the scratch
+// buffer instead of a marker image. Returns the number of deleted pixels.
+static int GuoHallIteration_optimized(cv::Mat& im, uchar* up, uchar* del, int iter)
 {
-    cv::Mat marker = cv::Mat::zeros(im.size(), CV_8UC1);
+    const int cols = im.cols;
+    int deleted = 0;
+
+    // 'up' keeps the row above in its state before this sub-iteration
+    memcpy(up, im.ptr<uchar>(0), cols);
 
     for (int i = 1; i < im.rows-1; i++)
     {
-        for (int j = 1; j < im.cols-1; j++)
+        uchar* cur = im.ptr<uchar>(i);
+        const uchar* down = im.ptr<uchar>(i+1);
+
+        for (int j = 1; j < cols-1; j++)
         {
-            uchar p2 = im.at<uchar>(i-1, j);
-            uchar p3 = im.at<uchar>(i-1, j+1);
-            uchar p4 = im.at<uchar>(i, j+1);
-            uchar p5 = im.at<uchar>(i+1, j+1);
-            uchar p6 = im.at<uchar>(i+1, j);
-            uchar p7 = im.at<uchar>(i+1, j-1);
-            uchar p8 = im.at<uchar>(i, j-1);
-            uchar p9 = im.at<uchar>(i-1, j-1);
+            del[j] = 0;
+            if (!cur[j])
+                continue;
+
+            uchar p2 = up[j] & 1;
+            uchar p3 = up[j+1] & 1;
+            uchar p4 = cur[j+1] & 1;
+            uchar p5 = down[j+1] & 1;
+            uchar p6 = down[j] & 1;
+            uchar p7 = down[j-1] & 1;
+            uchar p8 = cur[j-1] & 1;
+            uchar p9 = up[j-1] & 1;
 
             int C  = (!p2 & (p3 | p4)) + (!p4 & (p5 | p6)) +
                      (!p6 & (p7 | p8)) + (!p8 & (p9 | p2));
@@ -83,36 +109,518 @@ static void GuoHallIteration_optimized(cv::Mat& im, int iter)
             int m  = iter == 0 ? ((p6 | p7 | !p9) & p8) : ((p2 | p3 | !p5) & p4);
 
             if (C == 1 && (N >= 2 && N <= 3) & (m == 0))
-                marker.at<uchar>(i,j) = 1;
+            {
+                del[j] = 1;
+                deleted++;
+            }
         }
+
+        memcpy(up, cur, cols);
+
+        for (int j = 1; j < cols-1; j++)
+            if (del[j])
+                cur[j] = 0;
     }
 
-    im &= ~marker;
+    return deleted;
+}
+
+void GuoHallThinning_optimized(const cv::Mat& src, cv::Mat& dst, std::vector<uchar>& scratch)
+{
+    CV_Assert(CV_8UC1 == src.type());
+
+    // Binarization replaces both 'src / 255' and the final 'dst *= 255'
+    dst.create(src.size(), CV_8UC1);
+    for (int i = 0; i < src.rows; i++)
+    {
+        const uchar* psrc = src.ptr<uchar>(i);
+        uchar* pdst = dst.ptr<uchar>(i);
+        for (int j = 0; j < src.cols; j++)
+            pdst[j] = psrc[j] >= 128 ? 255 : 0;
+    }
+
+    if (src.rows < 3 || src.cols < 3)
+        return;
+
+    // No reallocation if the buffer was already sized for this image width
+    scratch.resize(2 * src.cols);
+    uchar* up = &scratch[0];
+    uchar* del = up + src.cols;
+
+    int deleted;
+    do
+    {
+        deleted  = GuoHallIteration_optimized(dst, up, del, 0);
+        deleted += GuoHallIteration_optimized(dst, up, del, 1);
+    }
+    while (deleted > 0);
 }
 
 void GuoHallThinning_optimized(const cv::Mat& src, cv::Mat& dst)
+{
+    std::vector<uchar> scratch;
+    GuoHallThinning_optimized(src, dst, scratch);
+}
+
+//
+// Bit-packed version: one bit per pixel, 64 pixels per machine word
+//
+
+typedef std::vector<uint64> BitRow;
+
+static inline uint64 westOf(const uint64* row, int w)
+{
+    // Bit k of the result holds pixel (x - 1) for pixel x at bit k
+    return (row[w] << 1) | (w > 0 ? row[w-1] >> 63 : 0);
+}
+
+static inline uint64 eastOf(const uint64* row, int w, int words)
+{
+    // Bit k of the result holds pixel (x + 1) for pixel x at bit k
+    return (row[w] >> 1) | (w + 1 < words ? row[w+1] << 63 : 0);
+}
+
+static inline uint64 atLeastTwo(uint64 a, uint64 b, uint64 c, uint64 d)
+{
+    return (a & b) | (c & d) | ((a | b) & (c | d));
+}
+
+// Evaluates C, N and m for 64 pixels of the row 'cur' at once and returns
+// the mask of pixels which have to be deleted in this sub-iteration
+static inline uint64 GuoHallDeletionMask(const uint64* up, const uint64* cur, const uint64* down,
+                                         int w, int words, int iter)
+{
+    const uint64 p2 = up[w];
+    const uint64 p3 = eastOf(up, w, words);
+    const uint64 p4 = eastOf(cur, w, words);
+    const uint64 p5 = eastOf(down, w, words);
+    const uint64 p6 = down[w];
+    const uint64 p7 = westOf(down, w);
+    const uint64 p8 = westOf(cur, w);
+    const uint64 p9 = westOf(up, w);
+
+    // C == 1: exactly one of the four terms is set
+    const uint64 c1 = ~p2 & (p3 | p4);
+    const uint64 c2 = ~p4 & (p5 | p6);
+    const uint64 c3 = ~p6 & (p7 | p8);
+    const uint64 c4 = ~p8 & (p9 | p2);
+    const uint64 C = (c1 | c2 | c3 | c4) & ~atLeastTwo(c1, c2, c3, c4);
+
+    // 2 <= min(N1, N2) <= 3: both counts are at least 2 and not both are 4
+    const uint64 n11 = p9 | p2, n12 = p3 | p4, n13 = p5 | p6, n14 = p7 | p8;
+    const uint64 n21 = p2 | p3, n22 = p4 | p5, n23 = p6 | p7, n24 = p8 | p9;
+    const uint64 N = atLeastTwo(n11, n12, n13, n14) & atLeastTwo(n21, n22, n23, n24) &
+                     ~(n11 & n12 & n13 & n14 & n21 & n22 & n23 & n24);
+
+    const uint64 m = iter == 0 ? ((p6 | p7 | ~p9) & p8) : ((p2 | p3 | ~p5) & p4);
+
+    return C & N & ~m;
+}
+
+static bool GuoHallIteration_bitpacked(BitRow& im, const BitRow& interior,
+                                       BitRow& up, BitRow& del, int rows, int words, int iter)
+{
+    uint64 changed = 0;
+
+    // 'up' keeps the row above in its state before this sub-iteration,
+    // so all decisions are made on the same snapshot as in GuoHallIteration
+    std::copy(im.begin(), im.begin() + words, up.begin());
+
+    for (int i = 1; i < rows-1; i++)
+    {
+        uint64* cur = &im[(size_t)i * words];
+        const uint64* down = cur + words;
+
+        for (int w = 0; w < words; w++)
+            del[w] = GuoHallDeletionMask(&up[0], cur, down, w, words, iter) & interior[w] & cur[w];
+
+        for (int w = 0; w < words; w++)
+        {
+            up[w] = cur[w];
+            cur[w] &= ~del[w];
+            changed |= del[w];
+        }
+    }
+
+    return changed != 0;
+}
+
+void GuoHallThinning_bitpacked(const cv::Mat& src, cv::Mat& dst)
+{
+    CV_Assert(CV_8UC1 == src.type());
+
+    const int rows = src.rows;
+    const int cols = src.cols;
+    const int words = (cols + 63) / 64;
+
+    // Pack the image, anything >= 128 is treated as foreground (same as src / 255)
+    BitRow im((size_t)rows * words, 0);
+    for (int i = 0; i < rows; i++)
+    {
+        const uchar* psrc = src.ptr<uchar>(i);
+        uint64* prow = &im[(size_t)i * words];
+        for (int j = 0; j < cols; j++)
+            prow[j >> 6] |= (uint64)(psrc[j] >> 7) << (j & 63);
+    }
+
+    // Only interior pixels may be deleted, border ones are used as neighbours only
+    BitRow interior(words, 0);
+    for (int j = 1; j < cols-1; j++)
+        interior[j >> 6] |= (uint64)1 << (j & 63);
+
+    BitRow up(words), del(words);
+
+    if (words > 0)
+    {
+        bool changed;
+        do
+        {
+            changed  = GuoHallIteration_bitpacked(im, interior, up, del, rows, words, 0);
+            changed |= GuoHallIteration_bitpacked(im, interior, up, del, rows, words, 1);
+        }
+        while (changed);
+    }
+
+    dst.create(src.size(), CV_8UC1);
+    for (int i = 0; i < rows; i++)
+    {
+        const uint64* prow = &im[(size_t)i * words];
+        uchar* pdst = dst.ptr<uchar>(i);
+        for (int j = 0; j < cols; j++)
+            pdst[j] = (uchar)(0 - (uchar)((prow[j >> 6] >> (j & 63)) & 1));
+    }
+}
+
+//
+// Frontier-driven version: only pixels around the latest deletions are re-evaluated
+//
+
+// Same decision as in GuoHallIteration for the pixel pointed by 'p' (values are 0/1)
+static inline bool GuoHallShouldDelete(const uchar* p, int step, int iter)
+{
+    uchar p2 = p[-step];
+    uchar p3 = p[-step + 1];
+    uchar p4 = p[1];
+    uchar p5 = p[step + 1];
+    uchar p6 = p[step];
+    uchar p7 = p[step - 1];
+    uchar p8 = p[-1];
+    uchar p9 = p[-step - 1];
+
+    int C  = (!p2 & (p3 | p4)) + (!p4 & (p5 | p6)) +
+             (!p6 & (p7 | p8)) + (!p8 & (p9 | p2));
+    int N1 = (p9 | p2) + (p3 | p4) + (p5 | p6) + (p7 | p8);
+    int N2 = (p2 | p3) + (p4 | p5) + (p6 | p7) + (p8 | p9);
+    int N  = N1 < N2 ? N1 : N2;
+    int m  = iter == 0 ? ((p6 | p7 | !p9) & p8) : ((p2 | p3 | !p5) & p4);
+
+    return C == 1 && (N >= 2 && N <= 3) & (m == 0);
+}
+
+// A pixel kept in a sub-iteration can only change its decision for the same
+// sub-iteration index after one of its neighbours is deleted, so every
+// sub-iteration index has its own worklist and its own 'pending' flag bit.
+static bool GuoHallIteration_frontier(cv::Mat& im, cv::Mat& flags, std::vector<int> pending[2],
+                                      std::vector<int>& current, std::vector<int>& deleted, int iter)
+{
+    uchar* pim = im.ptr<uchar>();
+    uchar* pflags = flags.ptr<uchar>();
+    const int step = im.cols;
+    const int rows = im.rows;
+    const uchar bit = (uchar)(1 << iter);
+
+    current.swap(pending[iter]);
+    pending[iter].clear();
+    deleted.clear();
+
+    for (size_t k = 0; k < current.size(); k++)
+    {
+        const int idx = current[k];
+        pflags[idx] &= ~bit;
+        if (pim[idx] && GuoHallShouldDelete(pim + idx, step, iter))
+            deleted.push_back(idx);
+    }
+
+    const int offsets[8] = { -step - 1, -step, -step + 1, -1, 1, step - 1, step, step + 1 };
+
+    for (size_t k = 0; k < deleted.size(); k++)
+    {
+        const int idx = deleted[k];
+        pim[idx] = 0;
+
+        for (int n = 0; n < 8; n++)
+        {
+            const int nidx = idx + offsets[n];
+            const int i = nidx / step, j = nidx - i * step;
+            if (i < 1 || i >= rows-1 || j < 1 || j >= step-1 || !pim[nidx])
+                continue;
+
+            if (!(pflags[nidx] & 1)) { pflags[nidx] |= 1; pending[0].push_back(nidx); }
+            if (!(pflags[nidx] & 2)) { pflags[nidx] |= 2; pending[1].push_back(nidx); }
+        }
+    }
+
+    return !deleted.empty();
+}
+
+void GuoHallThinning_frontier(const cv::Mat& src, cv::Mat& dst)
 {
     CV_Assert(CV_8UC1 == src.type());
 
     dst = src / 255;
+    CV_Assert(dst.isContinuous());
 
-    cv::Mat prev = cv::Mat::zeros(src.size(), CV_8UC1);
-    cv::Mat diff;
+    // Every interior foreground pixel has to be evaluated at least once
+    cv::Mat flags;
+    createScratch(flags, src.size());
+    flags = cv::Scalar(0);
+    std::vector<int> pending[2];
+    for (int i = 1; i < dst.rows-1; i++)
+    {
+        const uchar* pdst = dst.ptr<uchar>(i);
+        uchar* pflags = flags.ptr<uchar>(i);
+        for (int j = 1; j < dst.cols-1; j++)
+        {
+            if (pdst[j])
+            {
+                pflags[j] = 3;
+                pending[0].push_back(i * dst.cols + j);
+            }
+        }
+    }
+    pending[1] = pending[0];
 
+    std::vector<int> current, deleted;
+    bool changed;
     do
     {
-        GuoHallIteration_optimized(dst, 0);
-        GuoHallIteration_optimized(dst, 1);
-        cv::absdiff(dst, prev, diff);
-        dst.copyTo(prev);
+        changed  = GuoHallIteration_frontier(dst, flags, pending, current, deleted, 0);
+        changed |= GuoHallIteration_frontier(dst, flags, pending, current, deleted, 1);
+    }
+    while (changed);
+
+    dst *= 255;
+}
+
+//
+// Table-driven version: the decision is looked up by the 8-neighbour code
+//
+
+// The neighbourhood is kept as a 9-bit window of three 3-pixel columns while
+// scanning a row (bit 0 - upper, bit 1 - middle, bit 2 - lower pixel of a column):
+//     bits 6..8 - column j-1 (p9, p8, p7)
+//     bits 3..5 - column j   (p2, p1, p6)
+//     bits 0..2 - column j+1 (p3, p4, p5)
+// Dropping the central pixel p1 (bit 4) gives the 8-bit table index.
+#define GH_P3(n) (((n) >> 0) & 1)
+#define GH_P4(n) (((n) >> 1) & 1)
+#define GH_P5(n) (((n) >> 2) & 1)
+#define GH_P2(n) (((n) >> 3) & 1)
+#define GH_P6(n) (((n) >> 4) & 1)
+#define GH_P9(n) (((n) >> 5) & 1)
+#define GH_P8(n) (((n) >> 6) & 1)
+#define GH_P7(n) (((n) >> 7) & 1)
+
+#define GH_C(n)  ((!GH_P2(n) & (GH_P3(n) | GH_P4(n))) + (!GH_P4(n) & (GH_P5(n) | GH_P6(n))) + \
+                  (!GH_P6(n) & (GH_P7(n) | GH_P8(n))) + (!GH_P8(n) & (GH_P9(n) | GH_P2(n))))
+#define GH_N1(n) ((GH_P9(n) | GH_P2(n)) + (GH_P3(n) | GH_P4(n)) + (GH_P5(n) | GH_P6(n)) + (GH_P7(n) | GH_P8(n)))
+#define GH_N2(n) ((GH_P2(n) | GH_P3(n)) + (GH_P4(n) | GH_P5(n)) + (GH_P6(n) | GH_P7(n)) + (GH_P8(n) | GH_P9(n)))
+#define GH_N(n)  (GH_N1(n) < GH_N2(n) ? GH_N1(n) : GH_N2(n))
+#define GH_M0(n) ((GH_P6(n) | GH_P7(n) | !GH_P9(n)) & GH_P8(n))
+#define GH_M1(n) ((GH_P2(n) | GH_P3(n) | !GH_P5(n)) & GH_P4(n))
+
+#define GH_DEL0(n) (uchar)(GH_C(n) == 1 && GH_N(n) >= 2 && GH_N(n) <= 3 && GH_M0(n) == 0)
+#define GH_DEL1(n) (uchar)(GH_C(n) == 1 && GH_N(n) >= 2 && GH_N(n) <= 3 && GH_M1(n) == 0)
+
+#define GH_ROW0(n)   GH_DEL0(n), GH_DEL0(n+1), GH_DEL0(n+2), GH_DEL0(n+3), \
+                     GH_DEL0(n+4), GH_DEL0(n+5), GH_DEL0(n+6), GH_DEL0(n+7)
+#define GH_ROW1(n)   GH_DEL1(n), GH_DEL1(n+1), GH_DEL1(n+2), GH_DEL1(n+3), \
+                     GH_DEL1(n+4), GH_DEL1(n+5), GH_DEL1(n+6), GH_DEL1(n+7)
+#define GH_TABLE(R)  R(0),   R(8),   R(16),  R(24),  R(32),  R(40),  R(48),  R(56),  \
+                     R(64),  R(72),  R(80),  R(88),  R(96),  R(104), R(112), R(120), \
+                     R(128), R(136), R(144), R(152), R(160), R(168), R(176), R(184), \
+                     R(192), R(200), R(208), R(216), R(224), R(232), R(240), R(248)
+
+static const uchar GuoHallTable[2][256] =
+{
+    { GH_TABLE(GH_ROW0) },
+    { GH_TABLE(GH_ROW1) }
+};
+
+static inline int GuoHallColumn(const uchar* up, const uchar* cur, const uchar* down, int j)
+{
+    return up[j] | (cur[j] << 1) | (down[j] << 2);
+}
+
+static bool GuoHallIteration_table(cv::Mat& im, uchar* up, uchar* del, int iter)
+{
+    const uchar* table = GuoHallTable[iter];
+    const int cols = im.cols;
+    bool changed = false;
+
+    // 'up' keeps the row above in its state before this sub-iteration
+    memcpy(up, im.ptr<uchar>(0), cols);
+
+    for (int i = 1; i < im.rows-1; i++)
+    {
+        uchar* cur = im.ptr<uchar>(i);
+        const uchar* down = im.ptr<uchar>(i+1);
+
+        int window = (GuoHallColumn(up, cur, down, 0) << 3) | GuoHallColumn(up, cur, down, 1);
+
+        for (int j = 1; j < cols-1; j++)
+        {
+            window = ((window << 3) | GuoHallColumn(up, cur, down, j+1)) & 0x1FF;
+            del[j] = table[(window & 0x0F) | ((window >> 1) & 0xF0)] & cur[j];
+        }
+
+        memcpy(up, cur, cols);
+
+        for (int j = 1; j < cols-1; j++)
+        {
+            changed |= del[j] != 0;
+            cur[j] &= ~del[j];
+        }
+    }
+
+    return changed;
+}
+
+void GuoHallThinning_table(const cv::Mat& src, cv::Mat& dst)
+{
+    CV_Assert(CV_8UC1 == src.type());
+
+    dst = src / 255;
+
+    std::vector<uchar> up(src.cols), del(src.cols);
+
+    if (src.rows >= 3 && src.cols >= 3)
+    {
+        bool changed;
+        do
+        {
+            changed  = GuoHallIteration_table(dst, &up[0], &del[0], 0);
+            changed |= GuoHallIteration_table(dst, &up[0], &del[0], 1);
+        }
+        while (changed);
+    }
+
+    dst *= 255;
+}
+
+//
+// Parallel version: horizontal bands are processed concurrently
+//
+
+// Phase 1 of a sub-iteration: the image is only read, so every band sees
+// the same snapshot including the halo rows owned by its neighbours
+class GuoHallMarkBody : public cv::ParallelLoopBody
+{
+public:
+    GuoHallMarkBody(const cv::Mat& im, cv::Mat& marker, int iter)
+        : im_(im), marker_(marker), table_(GuoHallTable[iter]) {}
+
+    void operator()(const cv::Range& range) const
+    {
+        const int cols = im_.cols;
+
+        for (int i = range.start; i < range.end; i++)
+        {
+            const uchar* up = im_.ptr<uchar>(i-1);
+            const uchar* cur = im_.ptr<uchar>(i);
+            const uchar* down = im_.ptr<uchar>(i+1);
+            uchar* pmarker = marker_.ptr<uchar>(i);
+
+            int window = (GuoHallColumn(up, cur, down, 0) << 3) | GuoHallColumn(up, cur, down, 1);
+
+            for (int j = 1; j < cols-1; j++)
+            {
+                window = ((window << 3) | GuoHallColumn(up, cur, down, j+1)) & 0x1FF;
+                pmarker[j] = table_[(window & 0x0F) | ((window >> 1) & 0xF0)] & cur[j];
+            }
+        }
+    }
+
+private:
+    const cv::Mat& im_;
+    cv::Mat& marker_;
+    const uchar* table_;
+};
+
+// Phase 2 of a sub-iteration: runs after all bands are marked
+class GuoHallApplyBody : public cv::ParallelLoopBody
+{
+public:
+    GuoHallApplyBody(cv::Mat& im, const cv::Mat& marker, int* changed)
+        : im_(im), marker_(marker), changed_(changed) {}
+
+    void operator()(const cv::Range& range) const
+    {
+        const int cols = im_.cols;
+        int count = 0;
+
+        for (int i = range.start; i < range.end; i++)
+        {
+            uchar* cur = im_.ptr<uchar>(i);
+            const uchar* pmarker = marker_.ptr<uchar>(i);
+
+            for (int j = 1; j < cols-1; j++)
+            {
+                count += pmarker[j];
+                cur[j] &= ~pmarker[j];
+            }
+        }
+
+        if (count)
+            CV_XADD(changed_, count);
+    }
+
+private:
+    cv::Mat& im_;
+    const cv::Mat& marker_;
+    int* changed_;
+};
+
+void GuoHallThinning_parallel(const cv::Mat& src, cv::Mat& dst, int nthreads)
+{
+    CV_Assert(CV_8UC1 == src.type());
+
+    // One band per worker. parallel_for_ runs no more than 'nstripes' bands
+    // at a time, so the thread count is limited without touching the global
+    // setting of OpenCV; more threads than its pool has are not available.
+    const int nstripes = nthreads > 0 ? nthreads : cv::getNumThreads();
+
+    dst = src / 255;
+
+    cv::Mat marker;
+    createScratch(marker, src.size());
+    const cv::Range interior(1, src.rows-1);
+
+    if (src.rows >= 3 && src.cols >= 3)
+    {
+        if (nstripes > 1)
+            Profiler_NoteOtherThreads();
+
+        int changed;
+        do
+        {
+            changed = 0;
+            for (int iter = 0; iter < 2; iter++)
+            {
+                cv::parallel_for_(interior, GuoHallMarkBody(dst, marker, iter), nstripes);
+                cv::parallel_for_(interior, GuoHallApplyBody(dst, marker, &changed), nstripes);
+            }
+        }
+        while (changed > 0);
     }
-    while (cv::countNonZero(diff) > 0);
 
     dst *= 255;
 }
 
 //
-// Sample performance report
+// Sample performance report. perf_skeleton prints the x-factors against a
+// stored run itself: --perf_write_baseline=base.json once, then
+// --perf_baseline=base.json fails the tests which became slower.
 //
 //           Name of Test               base          1           2          1          2
 //                                                                           vs         vs
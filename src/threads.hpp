@@ -0,0 +1,117 @@
+#pragma once
+
+#include "opencv2/core/core.hpp"
+
+#if defined _WIN32
+#  include <windows.h>
+#else
+#  include <pthread.h>
+#  include <sched.h>
+#endif
+
+// Minimal portable threads for the pipeline's own workers
+
+inline void yieldThread()
+{
+#if defined _WIN32
+    SwitchToThread();
+#else
+    sched_yield();
+#endif
+}
+
+#if defined _WIN32
+typedef HANDLE ThreadHandle;
+#else
+typedef pthread_t ThreadHandle;
+#endif
+
+typedef void (*ThreadFunc)(void*);
+
+// Must stay alive until the thread is joined
+struct ThreadStart
+{
+    ThreadFunc func;
+    void* arg;
+};
+
+#if defined _WIN32
+inline DWORD WINAPI threadEntry(LPVOID p)
+#else
+inline void* threadEntry(void* p)
+#endif
+{
+    const ThreadStart* start = (const ThreadStart*)p;
+    start->func(start->arg);
+    return 0;
+}
+
+inline void startThread(ThreadHandle& handle, ThreadStart* start)
+{
+#if defined _WIN32
+    handle = CreateThread(NULL, 0, threadEntry, start, 0, NULL);
+    CV_Assert(handle != NULL);
+#else
+    CV_Assert(0 == pthread_create(&handle, NULL, threadEntry, start));
+#endif
+}
+
+inline void joinThread(ThreadHandle handle)
+{
+#if defined _WIN32
+    WaitForSingleObject(handle, INFINITE);
+    CloseHandle(handle);
+#else
+    pthread_join(handle, NULL);
+#endif
+}
+
+// Mutex with a condition for threads which block instead of yielding
+class ThreadMonitor
+{
+public:
+    ThreadMonitor()
+    {
+#if defined _WIN32
+        InitializeCriticalSection(&mutex_);
+        InitializeConditionVariable(&cond_);
+#else
+        pthread_mutex_init(&mutex_, NULL);
+        pthread_cond_init(&cond_, NULL);
+#endif
+    }
+    ~ThreadMonitor()
+    {
+#if defined _WIN32
+        DeleteCriticalSection(&mutex_);
+#else
+        pthread_cond_destroy(&cond_);
+        pthread_mutex_destroy(&mutex_);
+#endif
+    }
+
+#if defined _WIN32
+    void lock() { EnterCriticalSection(&mutex_); }
+    void unlock() { LeaveCriticalSection(&mutex_); }
+    // Called with the mutex locked
+    void wait() { SleepConditionVariableCS(&cond_, &mutex_, INFINITE); }
+    void notifyAll() { WakeAllConditionVariable(&cond_); }
+#else
+    void lock() { pthread_mutex_lock(&mutex_); }
+    void unlock() { pthread_mutex_unlock(&mutex_); }
+    void wait() { pthread_cond_wait(&cond_, &mutex_); }
+    void notifyAll() { pthread_cond_broadcast(&cond_); }
+#endif
+
+private:
+    ThreadMonitor(const ThreadMonitor&);
+    ThreadMonitor& operator=(const ThreadMonitor&);
+
+#if defined _WIN32
+    CRITICAL_SECTION mutex_;
+    CONDITION_VARIABLE cond_;
+#else
+    pthread_mutex_t mutex_;
+    pthread_cond_t cond_;
+#endif
+};
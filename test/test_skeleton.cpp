@@ -2,8 +2,11 @@
 
 #include "skeleton_filter.hpp"
 #include "opencv2/imgproc/imgproc.hpp"
+#include "opencv2/highgui/highgui.hpp"
 
+#include <fstream>
 #include <iostream>
+#include <stdio.h>
 
 using namespace cv;
 
@@ -60,3 +63,377 @@ TEST(skeleton, resize_matches_opencv)
     // std::cout << "Difference:\n" << reference - result << std::endl;
     EXPECT_LT(maxDifference(reference, result), 2);
 }
+
+TEST(skeleton, resize_3to2_matches_reference_on_large_images)
+{
+    // Arrange: an odd width makes the float coordinates of ImageResize inexact
+    Mat image(6849, 4845, CV_8UC1);
+    randu(image, Scalar(0), Scalar(255));
+    Size sz(image.cols * 2 / 3, image.rows * 2 / 3);
+    ASSERT_TRUE(Kernels_Select(KERNEL_RESIZE, "3to2"));
+
+    // Act
+    Mat result, reference;
+    Kernels_ImageResize()(image, result, sz);
+    ImageResize(image, reference, sz);
+
+    // Assert
+    EXPECT_FALSE(ImageResize_3to2_supported(image.size(), sz));
+    EXPECT_TRUE(ImageResize_3to2_supported(Size(3840, 2160), Size(2560, 1440)));
+    EXPECT_EQ(0, maxDifference(reference, result));
+}
+
+TEST(skeleton, thinning_bitpacked_matches_reference)
+{
+    // Arrange: width is not a multiple of 64 to cover partial words
+    Mat image(77, 131, CV_8UC1);
+    randu(image, Scalar(0), Scalar(255));
+    threshold(image, image, 200, 255, THRESH_BINARY_INV);
+
+    // Act
+    Mat result;
+    GuoHallThinning_bitpacked(image, result);
+
+    // Assert
+    Mat reference;
+    GuoHallThinning(image, reference);
+    EXPECT_EQ(0, maxDifference(reference, result));
+}
+
+TEST(skeleton, stream_matches_skeletonize)
+{
+    // Arrange
+    const Size sz(150, 97);
+    const int frames = 6;
+    SkeletonStream stream(sz, frames);
+
+    // Act: all frames fit into the input queue, so nothing blocks
+    Mat frame;
+    for (int i = 0; i < frames; i++)
+    {
+        GenerateSyntheticFrame(frame, sz, i);
+        ASSERT_TRUE(stream.push(frame));
+    }
+    stream.close();
+
+    // Assert
+    Mat result;
+    for (int i = 0; i < frames; i++)
+    {
+        ASSERT_TRUE(stream.pop(result));
+
+        Mat reference;
+        GenerateSyntheticFrame(frame, sz, i);
+        skeletonize(frame, reference, false);
+        EXPECT_EQ(0, maxDifference(reference, result));
+    }
+    EXPECT_FALSE(stream.pop(result));
+    EXPECT_EQ(frames, stream.stats().frames);
+}
+
+TEST(skeleton, profiler_records_every_stage)
+{
+    // Arrange
+    Mat input(60, 90, CV_8UC3);
+    randu(input, Scalar::all(0), Scalar::all(255));
+    const bool was_enabled = Profiler_IsEnabled();
+    Profiler_SetEnabled(true);
+    Profiler_Reset();
+
+    // Act
+    Mat output;
+    skeletonize(input, output, false);
+    skeletonize(input, output, false);
+    std::vector<ProfilerStageStats> stats = Profiler_GetStats();
+    Profiler_SetEnabled(was_enabled);
+
+    // Assert
+    const char* stages[] = { "skeletonize", "convertcolor", "resize", "threshold", "thinning", "inversion" };
+    for (size_t i = 0; i < sizeof(stages) / sizeof(stages[0]); i++)
+    {
+        int calls = 0;
+        for (size_t j = 0; j < stats.size(); j++)
+        {
+            if (stats[j].name == stages[i])
+            {
+                calls = stats[j].calls;
+                EXPECT_LE(stats[j].min_ms, stats[j].median_ms);
+                EXPECT_LE(stats[j].median_ms, stats[j].p99_ms);
+                EXPECT_LE(stats[j].p99_ms, stats[j].max_ms);
+            }
+        }
+        EXPECT_EQ(2, calls) << stages[i];
+    }
+}
+
+TEST(skeleton, profiler_hardware_counters_are_optional)
+{
+    // Arrange
+    Mat input(60, 90, CV_8UC3);
+    randu(input, Scalar::all(0), Scalar::all(255));
+    const bool was_enabled = Profiler_IsEnabled();
+    const bool had_counters = Profiler_HardwareCountersEnabled();
+    Profiler_SetEnabled(true);
+    const bool counters = Profiler_SetHardwareCounters(true);
+    Profiler_Reset();
+
+    // Act
+    Mat output;
+    skeletonize(input, output, false);
+    std::vector<ProfilerStageStats> stats = Profiler_GetStats();
+    Profiler_SetHardwareCounters(had_counters);
+    Profiler_SetEnabled(was_enabled);
+
+    // Assert: timings are there in any case, events only with counters
+    ASSERT_FALSE(stats.empty());
+    for (size_t i = 0; i < stats.size(); i++)
+    {
+        EXPECT_EQ(1, stats[i].calls) << stats[i].name;
+        if (counters && stats[i].name == "thinning")
+            EXPECT_GT(stats[i].events.cycles, 0);
+        if (!counters)
+            EXPECT_EQ(-1, stats[i].events.cycles) << stats[i].name;
+    }
+}
+
+TEST(skeleton, profiler_counts_stage_memory)
+{
+    // Arrange
+    Mat input(60, 90, CV_8UC3);
+    randu(input, Scalar::all(0), Scalar::all(255));
+    const bool was_enabled = Profiler_IsEnabled();
+    const bool was_pooled = MatPool_IsEnabled();
+    Profiler_SetEnabled(true);
+    Profiler_Reset();
+    MatPool_SetEnabled(false);
+
+    // Act
+    Mat output;
+    skeletonize(input, output, false);
+    std::vector<ProfilerStageStats> stats = Profiler_GetStats();
+    Profiler_SetEnabled(was_enabled);
+    MatPool_SetEnabled(was_pooled);
+
+    // Assert: without the pool the gray and the thinned images are allocated by their stages
+    const char* stages[] = { "convertcolor", "thinning", "skeletonize" };
+    const int64 sizes[] = { 90 * 60, 60 * 40, 90 * 60 + 60 * 40 };
+    for (size_t i = 0; i < sizeof(stages) / sizeof(stages[0]); i++)
+    {
+        bool found = false;
+        for (size_t j = 0; j < stats.size(); j++)
+        {
+            if (stats[j].name != stages[i])
+                continue;
+            found = true;
+            EXPECT_GE(stats[j].allocations, 1) << stages[i];
+            EXPECT_GE(stats[j].alloc_bytes, sizes[i]) << stages[i];
+            EXPECT_GE(stats[j].peak_bytes, sizes[i]) << stages[i];
+            EXPECT_LE(stats[j].peak_bytes, stats[j].alloc_bytes) << stages[i];
+        }
+        EXPECT_TRUE(found) << stages[i];
+    }
+}
+
+TEST(skeleton, profiler_marks_stages_with_work_on_other_threads)
+{
+    // Arrange
+    const bool was_enabled = Profiler_IsEnabled();
+    Profiler_SetEnabled(true);
+    Profiler_Reset();
+
+    // Act
+    {
+        PROFILE_SCOPE(outer);
+        {
+            PROFILE_SCOPE(handoff);
+            Profiler_NoteOtherThreads();
+        }
+        PROFILE_SCOPE(after);
+    }
+    std::vector<ProfilerStageStats> stats = Profiler_GetStats();
+    Profiler_SetEnabled(was_enabled);
+
+    // Assert: the enclosing scopes are marked, the one opened after is not
+    const char* stages[] = { "outer", "handoff", "after" };
+    const bool marked[] = { true, true, false };
+    for (size_t i = 0; i < sizeof(stages) / sizeof(stages[0]); i++)
+    {
+        bool found = false;
+        for (size_t j = 0; j < stats.size(); j++)
+        {
+            if (stats[j].name != stages[i])
+                continue;
+            found = true;
+            EXPECT_EQ(marked[i], stats[j].events_calling_thread_only) << stages[i];
+        }
+        EXPECT_TRUE(found) << stages[i];
+    }
+}
+
+TEST(skeleton, exact_kernels_give_the_same_skeleton)
+{
+    // Arrange
+    Mat input(90, 120, CV_8UC3);
+    randu(input, Scalar::all(0), Scalar::all(255));
+    const KernelInfo initial = Kernels_Selected(KERNEL_THINNING);
+
+    ASSERT_TRUE(Kernels_Select(KERNEL_THINNING, "baseline"));
+    Mat reference;
+    skeletonize(input, reference, false);
+
+    // Act & Assert
+    std::vector<KernelInfo> kernels = Kernels_List(KERNEL_THINNING);
+    for (size_t i = 0; i < kernels.size(); i++)
+    {
+        if (!(kernels[i].flags & KERNEL_EXACT) || !Kernels_Supported(kernels[i]))
+            continue;
+        ASSERT_TRUE(Kernels_Configure("thinning=" + kernels[i].name));
+
+        Mat result;
+        skeletonize(input, result, false);
+        EXPECT_EQ(0, maxDifference(reference, result)) << kernels[i].name;
+    }
+
+    // An unknown kernel keeps the previous choice
+    EXPECT_FALSE(Kernels_Select(KERNEL_THINNING, "no-such-kernel"));
+    EXPECT_EQ(kernels.back().name, Kernels_Selected(KERNEL_THINNING).name);
+
+    Kernels_Select(KERNEL_THINNING, initial.name);
+}
+
+TEST(skeleton, autotune_caches_the_choice)
+{
+    // Arrange
+    const std::string cache_path = "autotune_test.cache";
+    const std::string other_cache_path = "autotune_test_other.cache";
+    remove(cache_path.c_str());
+    remove(other_cache_path.c_str());
+    KernelInfo initial[KERNEL_STAGE_COUNT];
+    for (int s = 0; s < KERNEL_STAGE_COUNT; s++)
+        initial[s] = Kernels_Selected((KernelStage)s);
+
+    // Act
+    const int measured = Kernels_Autotune(Size(150, 96), cache_path);
+    const int measured_again = Kernels_Autotune(Size(150, 96), cache_path);
+    const int measured_other = Kernels_Autotune(Size(150, 96), other_cache_path);
+
+    // Assert: every cache file gets its own decisions
+    EXPECT_EQ(KERNEL_STAGE_COUNT, measured);
+    EXPECT_EQ(0, measured_again);
+    EXPECT_EQ(KERNEL_STAGE_COUNT, measured_other);
+
+    std::ifstream cache(cache_path.c_str());
+    std::string line;
+    int lines = 0;
+    while (std::getline(cache, line))
+        lines++;
+    EXPECT_EQ(KERNEL_STAGE_COUNT, lines);
+
+    for (int s = 0; s < KERNEL_STAGE_COUNT; s++)
+    {
+        EXPECT_TRUE(Kernels_Supported(Kernels_Selected((KernelStage)s)));
+        Kernels_Select((KernelStage)s, initial[s].name);
+    }
+    cache.close();
+    remove(cache_path.c_str());
+    remove(other_cache_path.c_str());
+}
+
+TEST(skeleton, autotune_returns_kernels_without_selecting_them)
+{
+    // Arrange
+    const std::string cache_path = "autotune_set_test.cache";
+    remove(cache_path.c_str());
+    std::string initial[KERNEL_STAGE_COUNT];
+    for (int s = 0; s < KERNEL_STAGE_COUNT; s++)
+        initial[s] = Kernels_Selected((KernelStage)s).name;
+
+    // Act
+    KernelSet kernels;
+    Kernels_Autotune(Size(120, 81), kernels, cache_path);
+
+    // Assert: the selection of other callers stays as it was
+    EXPECT_TRUE(kernels.convert != 0);
+    EXPECT_TRUE(kernels.resize != 0);
+    EXPECT_TRUE(kernels.thinning != 0);
+    for (int s = 0; s < KERNEL_STAGE_COUNT; s++)
+        EXPECT_EQ(initial[s], Kernels_Selected((KernelStage)s).name);
+    remove(cache_path.c_str());
+}
+
+TEST(skeleton, image_writer_saves_a_copy)
+{
+    // Arrange
+    const ImageDumpFormat initial = ImageWriter_GetFormat();
+    ImageWriter_SetFormat(IMAGE_DUMP_PNM);
+    Mat image(40, 60, CV_8UC1);
+    randu(image, Scalar::all(0), Scalar::all(255));
+    const Mat expected = image.clone();
+
+    // Act
+    ImageWriter_Write("image_writer_test.png", image);
+    image.setTo(Scalar::all(0));
+    const int failed = ImageWriter_Flush();
+
+    // Assert
+    EXPECT_EQ(0, failed);
+    Mat saved = imread("image_writer_test.pgm", IMREAD_GRAYSCALE);
+    ASSERT_FALSE(saved.empty());
+    EXPECT_EQ(0, maxDifference(expected, saved));
+
+    remove("image_writer_test.pgm");
+    ImageWriter_SetFormat(initial);
+}
+
+TEST(skeleton, synthetic_document_is_deterministic)
+{
+    // Act
+    Mat first, second;
+    GenerateSyntheticDocument(first, Size(320, 240), 3, 0.2);
+    GenerateSyntheticDocument(second, Size(320, 240), 3, 0.2);
+
+    // Assert
+    ASSERT_EQ(CV_8UC1, first.type());
+    EXPECT_EQ(0, maxDifference(first, second));
+
+    const double density = (double)countNonZero(first) / first.total();
+    EXPECT_NEAR(0.2, density, 0.05);
+}
+
+TEST(skeleton, mat_pool_reuses_aligned_blocks)
+{
+    // Arrange
+    const bool was_enabled = MatPool_IsEnabled();
+    MatPool_SetEnabled(true);
+    Mat input(60, 90, CV_8UC3);
+    randu(input, Scalar::all(0), Scalar::all(255));
+
+    // Act
+    Mat first;
+    first.allocator = MatPool_Allocator();
+    first.create(300, 400, CV_8UC1);
+    const uchar* first_data = first.data;
+    first.release();
+
+    const MatPoolStats before = MatPool_GetStats();
+    const MemoryCounters memory_before = Memory_ReadCounters();
+    Mat second;
+    second.allocator = MatPool_Allocator();
+    second.create(299, 400, CV_8UC1);
+    const MemoryCounters memory_after = Memory_ReadCounters();
+    const MatPoolStats after = MatPool_GetStats();
+
+    Mat pooled, plain;
+    skeletonize(input, pooled, false);
+    MatPool_SetEnabled(false);
+    skeletonize(input, plain, false);
+    MatPool_SetEnabled(was_enabled);
+
+    // Assert: a slightly smaller image fits into the released block
+    EXPECT_EQ(0u, (size_t)first_data % 64);
+    EXPECT_EQ(first_data, second.data);
+    EXPECT_EQ(before.hits + 1, after.hits);
+    EXPECT_EQ(memory_before.allocations, memory_after.allocations);
+    EXPECT_EQ(memory_before.reuses + 1, memory_after.reuses);
+    EXPECT_EQ(0, maxDifference(pooled, plain));
+}